@@ -1,30 +1,24 @@
 #include "apu.hpp"
 #include "util.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
 namespace aud {
 
 APU::APU(mapper::NESMapper &mapper, Registers &registers)
-    : mapper_(mapper), registers_(registers) {
-  (void)mapper_;
-  (void)registers_;
-  channels_.emplace(ChannelId::PULSE_1,
-                    std::make_unique<Channel>(ChannelId::PULSE_1,
-                                              Generator::Make<Pulse>(),
-                                              registers_));
-  channels_.emplace(ChannelId::PULSE_2,
-                    std::make_unique<Channel>(ChannelId::PULSE_2,
-                                              Generator::Make<Pulse>(),
-                                              registers_));
-  channels_.emplace(ChannelId::TRIANGLE,
-                    std::make_unique<Channel>(ChannelId::TRIANGLE,
-                                              Generator::Make<Triangle>(),
-                                              registers_));
-  channels_.emplace(ChannelId::NOISE,
-                    std::make_unique<Channel>(ChannelId::NOISE,
-                                              Generator::Make<Noise>(),
-                                              registers_));
-  dmc_unit_ =
-      std::make_unique<DMCUnit>(Generator::Make<DMC>(), registers_, mapper_);
+    : mapper_(mapper), registers_(registers),
+      channels_{
+          Channel(ChannelId::PULSE_1, registers_),
+          Channel(ChannelId::PULSE_2, registers_),
+          Channel(ChannelId::TRIANGLE, registers_),
+          Channel(ChannelId::NOISE, registers_),
+      },
+      blip_(CpuFreq, SampleRate, MaxFrameSamples), raw_(MaxFrameSamples),
+      filter_(SampleRate), samples_(MaxFrameSamples) {
+  dmc_unit_ = std::make_unique<DMCUnit>(registers_, mapper_);
 }
 
 void APU::step() {
@@ -34,6 +28,176 @@ void APU::step() {
   frame_counter_.inc(channels_, *dmc_unit_, registers_);
 
   registers_.setFcStatus(frame_counter_.status(channels_, *dmc_unit_));
+
+  synthesize();
+}
+
+uint32_t APU::run(uint32_t n) {
+  uint32_t done = 0;
+  while (done < n) {
+    step();
+    ++done;
+    if (dmc_unit_->stallPending()) {
+      break;
+    }
+    auto k = std::min(n - done, quietSteps());
+    if (k > 0) {
+      frame_counter_.skip(channels_, *dmc_unit_, registers_, k);
+      time_ += k;
+      done += k;
+    }
+  }
+  return done;
+}
+
+uint32_t APU::quietSteps() const {
+  // a step that would change the IRQ line, or end the synthesis frame, has
+  // to run for real
+  bool irq = frame_counter_.frameIrqReady() || frame_counter_.dmcInterrupt();
+  if (irq != pending_irq_) {
+    return 0;
+  }
+  return std::min(FrameCycles - 1 - time_,
+                  frame_counter_.quietIncs(channels_, *dmc_unit_, registers_));
+}
+
+void APU::synthesize() {
+  uint8_t p1 = channels_[0].output();
+  uint8_t p2 = channels_[1].output();
+  uint8_t tri = channels_[2].output();
+  uint8_t noise = channels_[3].output();
+  uint8_t dmc = dmc_unit_->output();
+
+  auto amp = mixer_.mix(p1, p2, tri, noise, dmc);
+  if (amp != amp_) {
+    blip_.addDelta(time_, amp - amp_);
+    amp_ = amp;
+  }
+  if (stems_) {
+    stems_->add(time_, mixer_.solo(p1, p2, tri, noise, dmc));
+  }
+
+  if (++time_ == FrameCycles) {
+    blip_.endFrame(time_);
+    auto n = blip_.readSamples(raw_.data(), raw_.size());
+    filter_.process(raw_.data(), samples_.data(), n);
+    output_.push(samples_.data(), n);
+    if (stems_) {
+      stems_->endFrame(time_);
+    }
+    time_ = 0;
+    if (rate_control_) {
+      adjustRate();
+    }
+  }
+}
+
+void APU::enableStems(bool on) {
+  if (!on) {
+    stems_.reset();
+  } else if (!stems_) {
+    stems_ = std::make_unique<Stems>(MaxFrameSamples);
+    stems_->setRatio(blip_.ratio());
+  }
+}
+
+Stems::Stems(size_t max_samples)
+    : raw_(max_samples), samples_(max_samples),
+      frames_(max_samples * Count) {
+  for (size_t i = 0; i < Count; ++i) {
+    blips_.emplace_back(CpuFreq, SampleRate, max_samples);
+    filters_.emplace_back(SampleRate);
+  }
+}
+
+void Stems::add(uint32_t time, const std::array<int32_t, Count> &levels) {
+  for (size_t i = 0; i < Count; ++i) {
+    if (levels[i] != amps_[i]) {
+      blips_[i].addDelta(time, levels[i] - amps_[i]);
+      amps_[i] = levels[i];
+    }
+  }
+}
+
+void Stems::endFrame(uint32_t time) {
+  size_t n = 0;
+  for (size_t c = 0; c < Count; ++c) {
+    blips_[c].endFrame(time);
+    // every stem shares the same clock and ratio, so n comes out the same
+    n = blips_[c].readSamples(raw_.data(), raw_.size());
+    filters_[c].process(raw_.data(), samples_.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+      frames_[i * Count + c] = samples_[i];
+    }
+  }
+
+  // drop whole frames rather than tear the interleaving
+  size_t len = n * Count;
+  if (output_.capacity() - output_.size() >= len) {
+    output_.push(frames_.data(), len);
+  }
+}
+
+void Stems::setRatio(double ratio) {
+  for (auto &b : blips_) {
+    b.setRatio(ratio);
+  }
+}
+
+void APU::adjustRate() {
+  // NOTE(oren): the frontend runs a whole video frame in one burst and then
+  // waits on vsync, so the fill level is a sawtooth. Smooth it over a few
+  // video frames before steering.
+  avg_fill_ += (output_.size() - avg_fill_) / 32.0;
+  double err = (target_fill_ - avg_fill_) / target_fill_;
+  blip_.setRatio(1.0 + std::clamp(err, -1.0, 1.0) * MaxRateAdjust);
+  if (stems_) {
+    stems_->setRatio(blip_.ratio());
+  }
+}
+
+uint32_t APU::deferrableSteps() const {
+  bool irq = frame_counter_.frameIrqReady() || frame_counter_.dmcInterrupt();
+  if (irq != pending_irq_) {
+    return 1;
+  }
+
+  uint32_t n = FrameCycles - time_;
+  if (!pending_irq_) {
+    int frame = frameIrqIn();
+    if (frame > 0) {
+      n = std::min(n, static_cast<uint32_t>(frame));
+    }
+  }
+  // NOTE(oren): re-setting a flag that's already up restarts its delay,
+  // which briefly drops the IRQ line, so that step is an event either way
+  int flag = frame_counter_.frameFlagIn(registers_);
+  if (flag > 0) {
+    n = std::min(n, static_cast<uint32_t>(flag));
+  }
+  int dmc = frame_counter_.dmcFetchIn(*dmc_unit_);
+  if (dmc > 0) {
+    n = std::min(n, static_cast<uint32_t>(dmc));
+  }
+  return n;
+}
+
+void APU::setRateControl(bool on) {
+  rate_control_ = on;
+  avg_fill_ = target_fill_;
+  blip_.setRatio(1.0);
+  if (stems_) {
+    stems_->setRatio(1.0);
+  }
+}
+
+void APU::setLatency(double ms) {
+  double fill = ms * SampleRate / 1000.0;
+  if (fill < 1.0 || fill > output_.capacity() / 2.0) {
+    throw std::invalid_argument("Audio latency out of range: " +
+                                std::to_string(ms) + "ms");
+  }
+  target_fill_ = avg_fill_ = fill;
 }
 
 void APU::reset(bool force) {
@@ -51,8 +215,10 @@ void FrameCounter::inc(Channels &channels, DMCUnit &dmc_unit,
 
   frame_interrupt_flag_.dec();
 
-  for (auto &[id, chan] : channels) {
-    chan->config();
+  for (auto &chan : channels) {
+    if (regs.configDirty(chan.id())) {
+      chan.config();
+    }
   }
 
   if (regs.dmcEnableChange()) {
@@ -71,22 +237,15 @@ void FrameCounter::inc(Channels &channels, DMCUnit &dmc_unit,
     if (regs.inhibitIrq()) {
       frame_interrupt_flag_.clear();
     }
-    counter_ = 0;
   }
 
   if (cycle_toggle_) {
-    if (seq_.step(counter_) && !regs.inhibitIrq()) {
+    if (seq_.step() && !regs.inhibitIrq()) {
       // assert frame interrupt flag for this and the next two cycles, but don't
       // assert the CPU's IRQ line until the end of that time, leaving it
       // asserted until the frame interrupt flag is deasserted and stays so
       frame_interrupt_flag_.set(2);
     }
-    ++counter_;
-
-    if ((seq_.mode() == Sequencer::Mode::M0 && counter_ == 14915) ||
-        (seq_.mode() == Sequencer::Mode::M1 && counter_ == 18641)) {
-      counter_ = 0;
-    }
 
     bool done = dmc_unit.step();
     if (done && regs.dmcInterruptEnable()) {
@@ -98,8 +257,72 @@ void FrameCounter::inc(Channels &channels, DMCUnit &dmc_unit,
 
   cycle_toggle_ = !cycle_toggle_;
 
-  for (auto &[id, chan] : channels) {
-    chan->toggle();
+  for (auto &chan : channels) {
+    chan.clock(cycle_toggle_);
+  }
+}
+
+int FrameCounter::frameIrqIn(const Registers &regs) const {
+  if (frame_interrupt_flag_.status) {
+    return frame_interrupt_flag_.count;
+  } else if (regs.inhibitIrq()) {
+    return -1;
+  }
+
+  int apu_cycles = seq_.untilIrq();
+  if (apu_cycles < 0) {
+    return -1;
+  }
+  // the flag takes two more inc()s to reach the IRQ line
+  return incsUntil(apu_cycles) + 2;
+}
+
+int FrameCounter::frameFlagIn(const Registers &regs) const {
+  int apu_cycles = seq_.untilIrq();
+  if (apu_cycles < 0 || regs.inhibitIrq()) {
+    return -1;
+  }
+  return incsUntil(apu_cycles);
+}
+
+int FrameCounter::dmcFetchIn(const DMCUnit &dmc) const {
+  int steps = dmc.stepsToFetch();
+  return steps < 0 ? -1 : incsUntil(steps - 1);
+}
+
+// NOTE(oren): of k inc()s, (k + cycle_toggle_) / 2 step the sequencer and
+// the DMC and the rest clock the pulses, so each bound on those counts turns
+// into a bound on k. Channel timers may expire along the way as long as the
+// channel's output doesn't depend on it.
+uint32_t FrameCounter::quietIncs(const Channels &channels, const DMCUnit &dmc,
+                                 const Registers &regs) const {
+  if (frame_interrupt_flag_.count > 0 || seq_.pending() ||
+      regs.frameCounterResetPending()) {
+    return 0;
+  }
+  int64_t t = cycle_toggle_ ? 1 : 0;
+  int64_t steps = std::min<int64_t>(seq_.countdown(), dmc.quietSteps());
+  int64_t k = 2 * steps + 1 - t;
+  for (const auto &chan : channels) {
+    int64_t clocks = chan.quietClocks();
+    k = std::min(k, chan.isPulse() ? 2 * clocks + t : clocks);
+  }
+  return static_cast<uint32_t>(k);
+}
+
+void FrameCounter::skip(Channels &channels, DMCUnit &dmc, Registers &regs,
+                        uint32_t n) {
+  // with no reset pending this only clears the delay count, however many
+  // times inc() would have called it
+  regs.frameCounterReset();
+  uint32_t steps = (n + (cycle_toggle_ ? 1 : 0)) / 2;
+  seq_.skip(steps);
+  dmc.skip(steps);
+  for (auto &chan : channels) {
+    chan.skip(chan.isPulse() ? n - steps : n);
+  }
+  if (n & 1) {
+    cycle_toggle_ = !cycle_toggle_;
   }
 }
 
@@ -114,8 +337,8 @@ uint8_t FrameCounter::status(const Channels &channels,
     result |= util::BIT6;
   }
 
-  for (const auto &[id, chan] : channels) {
-    result |= chan->status();
+  for (const auto &chan : channels) {
+    result |= chan.status();
   }
 
   if (dmc_unit.bytesRemaining()) {
@@ -184,7 +407,7 @@ void SampleBuffer::fill() {
   if (bytes_remaining_ > 0 && empty_) {
     empty_ = false;
     pending_stall_ = true;
-    buf_ = mapper_.read(curr_addr_);
+    buf_ = mapper_.dmaRead(curr_addr_);
     if (curr_addr_ == 0xFFFF) {
       curr_addr_ = 0x8000;
     } else {
@@ -227,9 +450,6 @@ void SampleOutput::start_cycle(SampleBuffer &sbuf) {
   silence_ = sbuf.empty();
   if (!silence_) {
     shift_register_ = sbuf.get();
-    if (sbuf.isFirst()) {
-      output_level_ = 0x40;
-    }
   }
   bits_remaining_ = 8;
 }
@@ -248,39 +468,64 @@ void DMCUnit::config() {
   output_.setLevel(regs_.dmcDirectLoad());
   if (regs_.isEnabled(id_)) {
     sbuf_.enable();
-    gen_.on();
   } else {
     ticks_ = 0;
     sbuf_.disable();
     // TODO(oren): is this really needed?
     // output_.disable();
-    gen_.off();
   }
 }
 
+int DMCUnit::stepsToFetch() const {
+  if (sbuf_.empty() && sbuf_.bytesRemaining() == 0) {
+    return -1;
+  }
+  // the output unit pulls the next byte when its last bit shifts out; the
+  // timer reloads from the rate register on every expiry after this one
+  return timer_.remaining() +
+         (output_.bitsRemaining() - 1) * (regs_.dmcRate() >> 1);
+}
+
 bool DMCUnit::step() {
   ticks_++;
   if (timer_.tick()) {
     timer_.setPeriod(regs_.dmcRate());
     auto out_lvl = output_.clock(sbuf_);
     assert(out_lvl <= 127 || out_lvl == 0xFF);
-    gen_.change_output_level(out_lvl, timer_.period());
+    (void)out_lvl;
   }
   return sbuf_.pendingInterrupt();
 }
 
-bool Sequencer::step(int cycle_count) {
-  bool irq_required = (mode_ == Mode::M0 && cycle_count == 14914);
-
-  const auto qlt = QfLookup.find(mode_);
-  assert(qlt != QfLookup.end());
-  qf_ = qf_ || qlt->second.find(cycle_count) != qlt->second.end();
-
-  const auto hlt = HfLookup.find(mode_);
-  assert(hlt != HfLookup.end());
-  hf_ = hf_ || hlt->second.find(cycle_count) != hlt->second.end();
+bool Sequencer::advance() {
+  const auto &table = steps();
+  const auto &s = table[next_];
+  qf_ = qf_ || s.quarter;
+  hf_ = hf_ || s.half;
+
+  // count down to the following step, wrapping around the end of the frame
+  int prev = s.cycle;
+  next_ = (next_ + 1) % table.size();
+  int delta = table[next_].cycle - prev;
+  if (delta <= 0) {
+    delta += period();
+  }
+  countdown_ = delta - 1;
+  return s.irq;
+}
 
-  return irq_required;
+int Sequencer::untilIrq() const {
+  const auto &table = steps();
+  auto it = std::find_if(table.begin(), table.end(),
+                         [](const Step &s) { return s.irq; });
+  if (it == table.end()) {
+    return -1;
+  }
+  int delta = it->cycle - table[next_].cycle;
+  if (delta < 0) {
+    delta += period();
+  }
+  return countdown_ + delta;
 }
 
 void Sequencer::clock(Channels &channels) {
@@ -295,30 +540,18 @@ void Sequencer::clock(Channels &channels) {
 }
 
 void Sequencer::quarter_frame(Channels &channels) {
-  for (auto &[id, c] : channels) {
-    c->tick_linear();
-    c->tick_env();
+  for (auto &c : channels) {
+    c.tick_linear();
+    c.tick_env();
   }
 }
 void Sequencer::half_frame(Channels &channels) {
-  for (auto &[id, c] : channels) {
-    c->tick_len();
-    c->tick_sweep();
+  for (auto &c : channels) {
+    c.tick_len();
+    c.tick_sweep();
   }
 }
 
-const std::unordered_map<Sequencer::Mode, std::unordered_set<int>>
-    Sequencer::QfLookup = {
-        {Mode::M0, {3728, 7456, 11185, 14914}},
-        {Mode::M1, {3728, 7456, 11185, 18640}},
-};
-
-const std::unordered_map<Sequencer::Mode, std::unordered_set<int>>
-    Sequencer::HfLookup = {
-        {Mode::M0, {7456, 14914}},
-        {Mode::M1, {7456, 18640}},
-};
-
 void Envelope::tick(bool start) {
   if (start) {
     decay_level_ = 15;
@@ -368,45 +601,118 @@ void Sweep::tick(uint16_t curr_period) {
 }
 
 void Channel::config() {
+  period_ = isNoise() ? regs_.nsPeriod() : regs_.generatorPeriod(id_);
+
   if (isTriangle()) {
     lin_lc_.enable(true);
   } else if (isPulse()) {
-    mute_ = swp_.shouldMute(regs_.generatorPeriod(id_));
+    mute_ = swp_.shouldMute(period_);
     swp_.config(regs_, id_);
-    static_cast<Pulse &>(generator_).set_duty_cycle(regs_.dutyCycle(id_));
+    duty_ = regs_.dutyMode(id_);
   }
 
   if (lc_.config(regs_, id_)) {
     env_.reset();
-    // TODO(oren): reset pulse phase?
+    if (isPulse()) {
+      // writing the high timer byte restarts the sequencer
+      seq_ = 0;
+    }
   }
 
   env_.config(regs_, id_);
-  generator_.set_pitch(getPitch());
 }
 
-void Channel::toggle() {
-  if (isAudible()) {
-    generator_.on();
+void Channel::clock(bool apu_cycle) {
+  if (isPulse() && !apu_cycle) {
+    return;
+  }
+
+  if (timer_ > 0) {
+    --timer_;
+    return;
+  }
+  timer_ = period_;
+  advance(1);
+}
+
+uint32_t Channel::quietClocks() const {
+  bool fixed;
+  if (isTriangle()) {
+    fixed = force_mute_ || !(lc_.check() && lin_lc_.check() && period_ >= 2);
+  } else {
+    fixed = force_mute_ || mute_ || !checkLc() || env_.vol() == 0;
+  }
+  return fixed ? Unbounded : timer_;
+}
+
+void Channel::skip(uint32_t clocks) {
+  if (clocks <= timer_) {
+    timer_ -= clocks;
+    return;
+  }
+  // the first expiry takes timer_ + 1 clocks, the rest period_ + 1 each
+  clocks -= timer_ + 1u;
+  uint32_t len = period_ + 1u;
+  timer_ = period_ - clocks % len;
+  advance(1 + clocks / len);
+}
+
+void Channel::advance(uint32_t n) {
+  if (isPulse()) {
+    seq_ = (seq_ + n) & 0b111;
+  } else if (isTriangle()) {
+    // NOTE(oren): periods below 2 are ultrasonic, and just pop if we let the
+    // sequencer run
+    if (lc_.check() && lin_lc_.check() && period_ >= 2) {
+      seq_ = (seq_ + n) & 0b11111;
+    }
   } else {
-    generator_.off();
+    uint8_t tap = regs_.nsMode() ? 6 : 1;
+    for (; n > 0; --n) {
+      uint16_t fb = (lfsr_ ^ (lfsr_ >> tap)) & 0b1;
+      lfsr_ = (lfsr_ >> 1) | (fb << 14);
+    }
   }
 }
-void Channel::syncVolume() { generator_.set_volume((1.0 * env_.vol()) / 15.0); }
 
-// TODO(oren): pass the channel type rather than m
-// this should be a general goal for the registers module
-double Channel::calc_freq(uint16_t period) const {
-  uint32_t m = isPulse() ? 16 : 32;
-  static double cpu_freq = 1.789773e6;
-  return cpu_freq / (m * (period + 1));
+uint8_t Channel::output() const {
+  if (force_mute_) {
+    return 0;
+  } else if (isTriangle()) {
+    // the triangle holds its last value when silenced
+    return TriangleTable[seq_];
+  } else if (!checkLc() || mute_) {
+    return 0;
+  } else if (isPulse()) {
+    return DutyTable[duty_][seq_] ? env_.vol() : 0;
+  } else {
+    return (lfsr_ & 0b1) ? 0 : env_.vol();
+  }
 }
 
-double DMCUnit::calc_freq(uint16_t period) const {
-  static double cpu_freq = 1.789773e6;
-  return cpu_freq / period;
+Mixer::Mixer() {
+  pulse_[0] = 0;
+  for (size_t i = 1; i < pulse_.size(); ++i) {
+    pulse_[i] = std::lround(Volume * 95.52 / (8128.0 / i + 100.0));
+  }
+  tnd_[0] = 0;
+  for (size_t i = 1; i < tnd_.size(); ++i) {
+    tnd_[i] = std::lround(Volume * 163.67 / (24329.0 / i + 100.0));
+  }
 }
 
+const std::array<std::array<uint8_t, 8>, 4> Channel::DutyTable = {{
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1},
+}};
+
+const std::array<uint8_t, 32> Channel::TriangleTable = {
+    15, 14, 13, 12, 11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, 15,
+};
+
 const std::array<uint8_t, 0x20> LengthCounter::LengthTable = {
     10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14, // 00-0F
     12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30, // 10-1F
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "apu_registers.hpp"
-#include "gen_audio.hpp"
+#include "blip_buffer.hpp"
 #include "mappers/base_mapper.hpp"
+#include "output_filter.hpp"
+#include "sample_queue.hpp"
 
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 
 namespace aud {
 
@@ -104,27 +108,35 @@ private:
 class Channel {
 public:
   Channel() = delete;
-  Channel(ChannelId id, Generator &g, Registers &regs)
-      : generator_(g), id_(id), regs_(regs),
-        swp_(id == ChannelId::PULSE_1 ? -1 : 0) {}
+  Channel(ChannelId id, Registers &regs)
+      : id_(id), regs_(regs), swp_(id == ChannelId::PULSE_1 ? -1 : 0) {}
 
   bool isPulse() const {
     return (id_ == ChannelId::PULSE_1 || id_ == ChannelId::PULSE_2);
   }
   bool isTriangle() const { return id_ == ChannelId::TRIANGLE; }
   bool isNoise() const { return id_ == ChannelId::NOISE; }
+  ChannelId id() const { return id_; }
+  // Re-decode this channel's registers. Only needed after Registers reports
+  // the channel dirty.
   void config();
-  void toggle();
-  void syncVolume();
-
-  void tick_env() {
-    env_.tick(regs_.envStart(id_));
-    syncVolume();
-  }
+  // Advance the waveform timer. Pulse timers only count on APU cycles (every
+  // other CPU cycle).
+  void clock(bool apu_cycle);
+  // Timer clocks (calls to clock() that count) this channel can take without
+  // its output changing, or Unbounded if none will change it
+  uint32_t quietClocks() const;
+  // The same as that many timer clocks, in one go
+  void skip(uint32_t clocks);
+  // Current DAC input, 0-15
+  uint8_t output() const;
+
+  void tick_env() { env_.tick(regs_.envStart(id_)); }
   void tick_len() { lc_.tick(); }
   void tick_sweep() {
     if (isPulse()) {
-      swp_.tick(regs_.generatorPeriod(id_));
+      swp_.tick(period_);
+      mute_ = swp_.shouldMute(period_);
     }
   }
 
@@ -149,25 +161,16 @@ public:
 
   void forceMute(bool m) { force_mute_ = m; }
 
-private:
-  double getPitch() const {
-    if (isNoise()) {
-      return regs_.nsFreq();
-    } else if (isPulse()) {
-      return calc_freq(regs_.generatorPeriod(id_) + swp_.change());
-    } else {
-      return calc_freq(regs_.generatorPeriod(id_));
-    }
-  }
+  static constexpr uint32_t Unbounded = UINT32_MAX;
 
+private:
+  // step the waveform through n timer expiries
+  void advance(uint32_t n);
   bool checkLinc() const { return (!isTriangle() || lin_lc_.check()); }
   bool checkLc() const { return lc_.check(); }
   bool checkEnv() const { return (isTriangle() || env_.vol() > 0); }
   bool checkMute() const { return mute_ || force_mute_; }
 
-  double calc_freq(uint16_t period) const;
-
-  Generator &generator_;
   ChannelId id_;
   Registers &regs_;
   LengthCounter lc_;
@@ -176,9 +179,19 @@ private:
   Sweep swp_;
   bool mute_ = false;
   bool force_mute_ = false;
+
+  uint16_t period_ = 0;
+  uint16_t timer_ = 0;
+  uint8_t seq_ = 0;
+  uint8_t duty_ = 0;
+  uint16_t lfsr_ = 1;
+
+  static const std::array<std::array<uint8_t, 8>, 4> DutyTable;
+  static const std::array<uint8_t, 32> TriangleTable;
 };
 
-using Channels = std::unordered_map<ChannelId, std::unique_ptr<Channel>>;
+// Indexed by ChannelId. The DMC lives apart, in DMCUnit.
+using Channels = std::array<Channel, static_cast<size_t>(ChannelId::DMC)>;
 
 struct SampleBuffer {
   SampleBuffer(mapper::NESMapper &mapper, Registers &regs)
@@ -211,6 +224,7 @@ struct SampleBuffer {
     pending_stall_ = false;
     return tmp;
   }
+  bool stallPending() const { return pending_stall_; }
 
   void fill();
 
@@ -247,11 +261,12 @@ struct SampleOutput {
   }
 
   uint8_t bitsRemaining() const { return bits_remaining_; }
+  uint8_t level() const { return output_level_; }
 
 private:
   void start_cycle(SampleBuffer &sbuf);
   uint8_t shift_register_ = 0;
-  uint8_t output_level_ = 0x40;
+  uint8_t output_level_ = 0;
   uint8_t level_setting_ = 0;
   uint8_t bits_remaining_ = 8;
   bool silence_ = true;
@@ -264,6 +279,12 @@ struct SampleTimer {
   }
   uint16_t period() { return (period_ << 1); }
   bool tick();
+  // n ticks that don't reach an expiry
+  void skip(uint16_t n) { counter_ += n; }
+  // ticks until the timer next expires
+  uint16_t remaining() const {
+    return counter_ < period_ ? period_ - counter_ : 1;
+  }
 
 private:
   uint16_t counter_ = 0;
@@ -272,25 +293,38 @@ private:
 
 class DMCUnit {
 public:
-  DMCUnit(DMC &gen, Registers &regs, mapper::NESMapper &mapper)
-      : gen_(gen), regs_(regs), sbuf_(mapper, regs) {}
+  DMCUnit(Registers &regs, mapper::NESMapper &mapper)
+      : regs_(regs), sbuf_(mapper, regs) {}
 
   void config();
   bool step();
   uint16_t bytesRemaining() const { return sbuf_.bytesRemaining(); }
   bool empty() const { return sbuf_.empty() && sbuf_.bytesRemaining() == 0; }
   bool pendingStall() { return sbuf_.pendingStall(); }
+  bool stallPending() const { return sbuf_.stallPending(); }
   uint8_t status() const { return 0b1 << 4; }
+  // Current DAC input, 0-127
+  uint8_t output() const { return force_mute_ ? 0 : output_.level(); }
+  void forceMute(bool m) { force_mute_ = m; }
+  // Calls to step() until the one that may fetch a sample byte (and so stall
+  // the CPU or raise the DMC IRQ), or -1 if the DMC is idle
+  int stepsToFetch() const;
+  // Calls to step() before the one where the sample timer expires. Nothing
+  // happens on the ones before, so they can be skipped.
+  uint16_t quietSteps() const { return timer_.remaining() - 1; }
+  void skip(uint16_t n) {
+    ticks_ += n;
+    timer_.skip(n);
+  }
 
 private:
-  double calc_freq(uint16_t period) const;
-  DMC &gen_;
   Registers &regs_;
   SampleBuffer sbuf_;
   SampleOutput output_;
   SampleTimer timer_;
   ChannelId id_ = ChannelId::DMC;
   uint16_t ticks_ = 0;
+  bool force_mute_ = false;
 };
 
 class Sequencer {
@@ -301,8 +335,14 @@ public:
   };
   Sequencer() : mode_(Mode::M0) {}
 
-  // returns true if we should generate an IRQ signal
-  bool step(int cycle_count);
+  // Advance one APU cycle. Returns true if we should generate an IRQ signal
+  bool step() {
+    if (countdown_ > 0) {
+      --countdown_;
+      return false;
+    }
+    return advance();
+  }
   void setMode(Mode m) { mode_ = m; }
   Mode mode() const { return mode_; }
 
@@ -311,18 +351,60 @@ public:
       qf_ = true;
       hf_ = true;
     }
+    next_ = 0;
+    countdown_ = steps()[0].cycle;
   }
 
   void clock(Channels &channels);
 
+  // Calls to step() that only count down, and to clock() that do nothing
+  int countdown() const { return countdown_; }
+  bool pending() const { return qf_ || hf_; }
+  void skip(int n) { countdown_ -= n; }
+
+  // APU cycles until the step that raises the frame IRQ, counting the next
+  // call to step() as 0, or -1 if this mode never raises it
+  int untilIrq() const;
+
 private:
+  struct Step {
+    int cycle;
+    bool quarter;
+    bool half;
+    bool irq;
+  };
+  using Table = std::array<Step, 4>;
+
+  static constexpr Table M0Steps = {{
+      {3728, true, false, false},
+      {7456, true, true, false},
+      {11185, true, false, false},
+      {14914, true, true, true},
+  }};
+  static constexpr int M0Period = 14915;
+
+  static constexpr Table M1Steps = {{
+      {3728, true, false, false},
+      {7456, true, true, false},
+      {11185, true, false, false},
+      {18640, true, true, false},
+  }};
+  static constexpr int M1Period = 18641;
+
+  const Table &steps() const {
+    return mode_ == Mode::M0 ? M0Steps : M1Steps;
+  }
+  int period() const { return mode_ == Mode::M0 ? M0Period : M1Period; }
+
+  bool advance();
   void quarter_frame(Channels &channels);
   void half_frame(Channels &channels);
   Mode mode_;
   bool qf_ = false;
   bool hf_ = false;
-  static const std::unordered_map<Mode, std::unordered_set<int>> QfLookup;
-  static const std::unordered_map<Mode, std::unordered_set<int>> HfLookup;
+  // index of the next step, and APU cycles left until it
+  size_t next_ = 0;
+  int countdown_ = M0Steps[0].cycle;
 };
 
 class FrameCounter {
@@ -335,19 +417,35 @@ public:
   bool frameIrqReady() const {
     return frame_interrupt_flag_.status && !frame_interrupt_flag_.count;
   }
+  // Number of further inc() calls before frameIrqReady() holds (0 if it
+  // already does), or -1 if no frame IRQ is coming. Only valid until the
+  // next write to $4015 or $4017 takes effect.
+  int frameIrqIn(const Registers &regs) const;
+  // Number of inc() calls up to and including the one that (re)sets the
+  // frame interrupt flag, or -1 if none will
+  int frameFlagIn(const Registers &regs) const;
+  // Number of inc() calls up to and including the one where the DMC may
+  // fetch, or -1 if it's idle
+  int dmcFetchIn(const DMCUnit &dmc) const;
+  // Number of inc() calls that would do nothing but move timers along, so
+  // skip() can stand in for them
+  uint32_t quietIncs(const Channels &channels, const DMCUnit &dmc,
+                     const Registers &regs) const;
+  void skip(Channels &channels, DMCUnit &dmc, Registers &regs, uint32_t n);
   void clearFrameInterrupt() { frame_interrupt_flag_.clear(); }
   bool dmcInterrupt() const { return dmc_interrupt_; }
 
-  int count() const { return counter_; }
-
   void reset() {
     cycle_toggle_ = true;
     frame_interrupt_flag_.clear();
   }
 
 private:
+  // inc() calls up to and including the one that runs the APU cycle k cycles
+  // from now. The sequencer and DMC only step on every other inc().
+  int incsUntil(int k) const { return 2 * k + (cycle_toggle_ ? 1 : 2); }
+
   Sequencer seq_;
-  int counter_;
   struct {
     bool status = false;
     int count = 0;
@@ -371,17 +469,73 @@ private:
   bool cycle_toggle_ = true;
 };
 
+// The 2A03's nonlinear DAC, as lookup tables over the summed channel outputs.
+// See https://www.nesdev.org/wiki/APU_Mixer
+class Mixer {
+public:
+  Mixer();
+  int32_t mix(uint8_t p1, uint8_t p2, uint8_t tri, uint8_t noise,
+              uint8_t dmc) const {
+    return pulse_[p1 + p2] + tnd_[3 * tri + 2 * noise + dmc];
+  }
+
+  // Each channel through the mixer with the others silent. These don't sum
+  // to the mix, since the DAC is nonlinear.
+  std::array<int32_t, 5> solo(uint8_t p1, uint8_t p2, uint8_t tri,
+                              uint8_t noise, uint8_t dmc) const {
+    return {pulse_[p1], pulse_[p2], tnd_[3 * tri], tnd_[2 * noise], tnd_[dmc]};
+  }
+
+private:
+  static constexpr double Volume = 24000.0;
+  std::array<int32_t, 31> pulse_;
+  std::array<int32_t, 203> tnd_;
+};
+
+// Per-channel output (pulse 1, pulse 2, triangle, noise, DMC), band limited
+// and filtered the same way as the mix. Emitted as interleaved 5 channel
+// frames on a queue of its own.
+class Stems {
+public:
+  static constexpr size_t Count = 5;
+
+  explicit Stems(size_t max_samples);
+
+  void add(uint32_t time, const std::array<int32_t, Count> &levels);
+  void endFrame(uint32_t time);
+  void setRatio(double ratio);
+
+  SampleQueue &output() { return output_; }
+
+private:
+  std::vector<BlipBuffer> blips_;
+  std::vector<OutputFilter> filters_;
+  std::array<int32_t, Count> amps_ = {};
+  std::vector<float> raw_;
+  std::vector<int16_t> samples_;
+  std::vector<int16_t> frames_;
+  SampleQueue output_{1 << 16};
+};
+
 class APU {
 
 public:
   APU(mapper::NESMapper &mapper, Registers &registers);
   void step();
+  // The same as up to n calls to step(), stopping early after one that
+  // starts a DMC fetch so the caller can stall the CPU on the right cycle.
+  // Returns the number of steps run. Stretches where nothing but timers move
+  // are skipped in one go.
+  uint32_t run(uint32_t n);
   void reset(bool force = false);
+  // cid is a ChannelId, the DMC included
   void mute(int cid, bool m) {
-    ChannelId id{cid};
-    auto it = channels_.find(id);
-    if (it != channels_.end()) {
-      it->second->forceMute(m);
+    if (cid >= 0 && cid < static_cast<int>(channels_.size())) {
+      channels_[cid].forceMute(m);
+    } else if (cid == static_cast<int>(ChannelId::DMC)) {
+      dmc_unit_->forceMute(m);
+    } else {
+      throw std::invalid_argument("No APU channel " + std::to_string(cid));
     }
   }
 
@@ -389,13 +543,72 @@ public:
 
   bool stallCpu() { return dmc_unit_->pendingStall(); }
 
+  // Number of step() calls that may be deferred and then run back to back
+  // without changing what pendingIrq() and stallCpu() would have reported in
+  // between. The last of them may raise an IRQ, start a DMC fetch or finish a
+  // block of audio. Only valid until the next APU register access.
+  uint32_t deferrableSteps() const;
+
+  // Number of further step() calls until pendingIrq() reports the frame
+  // IRQ, or -1 if none is scheduled. Lets the caller schedule the interrupt
+  // rather than poll for it.
+  int frameIrqIn() const {
+    int n = frame_counter_.frameIrqIn(registers_);
+    return n < 0 ? n : n + 1;
+  }
+
+  SampleQueue &output() { return output_; }
+
+  // Also emit per-channel stems. Off by default, in which case they cost
+  // nothing.
+  void enableStems(bool on);
+  // nullptr unless stems are enabled
+  SampleQueue *stems() { return stems_ ? &stems_->output() : nullptr; }
+
+  // Target depth of the output queue. The output rate is nudged (by at most
+  // MaxRateAdjust) to hold the queue there, which locks audio to whatever
+  // pace the frontend actually runs the emulator at.
+  void setLatency(double ms);
+  double latency() const { return target_fill_ * 1000.0 / SampleRate; }
+
+  // Steer the output rate from the queue fill level. Only makes sense when
+  // something drains the queue in real time.
+  void setRateControl(bool on);
+
+  static constexpr double DefaultLatency = 50.0;
+
 private:
+  // CPU cycles per synthesis frame. Samples reach the output queue once per
+  // frame, so this bounds the added latency (~2.3ms).
+  static constexpr uint32_t FrameCycles = 4096;
+  static constexpr double MaxRateAdjust = 0.005;
+  static constexpr size_t MaxFrameSamples = static_cast<size_t>(
+      FrameCycles * SampleRate * (1.0 + MaxRateAdjust) / CpuFreq + 2);
+
+  void synthesize();
+  void adjustRate();
+  // steps after this one that can't change any output or flag
+  uint32_t quietSteps() const;
+
   mapper::NESMapper &mapper_;
   Registers &registers_;
   Channels channels_;
   FrameCounter frame_counter_;
   std::unique_ptr<DMCUnit> dmc_unit_;
   bool pending_irq_;
+
+  Mixer mixer_;
+  BlipBuffer blip_;
+  uint32_t time_ = 0;
+  int32_t amp_ = 0;
+  std::vector<float> raw_;
+  OutputFilter filter_;
+  std::vector<int16_t> samples_;
+  SampleQueue output_;
+  std::unique_ptr<Stems> stems_;
+  double target_fill_ = DefaultLatency * SampleRate / 1000.0;
+  double avg_fill_ = target_fill_;
+  bool rate_control_ = false;
 };
 
 } // namespace aud
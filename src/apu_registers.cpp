@@ -17,28 +17,35 @@ void Registers::write(CName r, uint8_t val, mapper::NESMapper &mapper) {
     generator_regs[static_cast<int>(r)] = val;
   }
 
+  if (r < CName::DMC_CTRL) {
+    config_dirty_ |= 0b1 << (r >> 2);
+  } else if (r == CName::STATUS) {
+    // enable bits feed every length counter
+    config_dirty_ = 0b1111;
+  }
+
   switch (r) {
   case P1_THI:
-    set_channel_flag(LcLoadFlags, ChannelId::PULSE_1);
-    set_channel_flag(EnvStartFlags, ChannelId::PULSE_1);
+    set_channel_flag(lc_load_flags_, ChannelId::PULSE_1);
+    set_channel_flag(env_start_flags_, ChannelId::PULSE_1);
     break;
   case P1_SWP:
-    set_channel_flag(SweepReloadFlags, ChannelId::PULSE_1);
+    set_channel_flag(sweep_reload_flags_, ChannelId::PULSE_1);
     break;
   case P2_THI:
-    set_channel_flag(LcLoadFlags, ChannelId::PULSE_2);
-    set_channel_flag(EnvStartFlags, ChannelId::PULSE_2);
+    set_channel_flag(lc_load_flags_, ChannelId::PULSE_2);
+    set_channel_flag(env_start_flags_, ChannelId::PULSE_2);
     break;
   case P2_SWP:
-    set_channel_flag(SweepReloadFlags, ChannelId::PULSE_2);
+    set_channel_flag(sweep_reload_flags_, ChannelId::PULSE_2);
     break;
   case TR_THI:
-    set_channel_flag(LcLoadFlags, ChannelId::TRIANGLE);
+    set_channel_flag(lc_load_flags_, ChannelId::TRIANGLE);
     tr_lin_load_pending = true;
     break;
   case NS_LCL:
-    set_channel_flag(LcLoadFlags, ChannelId::NOISE);
-    set_channel_flag(EnvStartFlags, ChannelId::NOISE);
+    set_channel_flag(lc_load_flags_, ChannelId::NOISE);
+    set_channel_flag(env_start_flags_, ChannelId::NOISE);
     break;
   case DMC_LOAD:
     dmc_direct_load = true;
@@ -64,36 +71,4 @@ void Registers::reload(CName r, mapper::NESMapper &m) {
   write(r, last_write_[static_cast<int>(r)], m);
 }
 
-double Registers::calc_duty_cycle(uint8_t val) const {
-  uint8_t d = (val & (util::BIT7 | util::BIT6)) >> 6;
-
-  switch (d & 0b11) {
-
-  case 0:
-    return 0.125;
-  case 1:
-    return 0.25;
-  case 2:
-    return 0.5;
-  case 3:
-    // TODO(oren): this should be a "negative polarity" quarter dc pulse
-    // return 0.25;
-    return 0.75;
-  default:
-    assert(false);
-  }
-}
-
-Registers::ChannelFlags Registers::EnvStartFlags = {
-    false, false, false, false, false,
-};
-
-Registers::ChannelFlags Registers::LcLoadFlags = {
-    true, true, true, true, false,
-};
-
-Registers::ChannelFlags Registers::SweepReloadFlags = {
-    false, false, false, false, false,
-};
-
 } // namespace aud
@@ -51,7 +51,7 @@ public:
   bool inhibitIrq() const { return inhibit_irq_; }
 
   bool frameCounterReset() {
-    static int count = 0;
+    auto &count = fc_reset_delay_;
     // delay frame control effects for a couple of cycles (maybe more?)
     if (!fc_reset_) {
       count = 0;
@@ -69,6 +69,9 @@ public:
     }
   }
 
+  // a $4017 write is still waiting out its delay
+  bool frameCounterResetPending() const { return fc_reset_; }
+
   bool clearFrameInterrupt() {
     return get_and_clear_flag(clear_frame_interrupt_);
   }
@@ -79,11 +82,20 @@ public:
 
   bool dmcEnableChange() { return get_and_clear_flag(dmc_en_changed); }
 
+  // Set by any write that may have changed a (non-DMC) channel's
+  // configuration, so channels only re-decode their registers when needed.
+  bool configDirty(ChannelId id) {
+    uint8_t bit = 0b1 << static_cast<uint8_t>(id);
+    bool dirty = config_dirty_ & bit;
+    config_dirty_ &= ~bit;
+    return dirty;
+  }
+
   bool envStart(ChannelId id) {
-    return get_and_clear_channel_flag(EnvStartFlags, id);
+    return get_and_clear_channel_flag(env_start_flags_, id);
   }
   uint8_t lcLoad(ChannelId id) {
-    if (get_and_clear_channel_flag(LcLoadFlags, id)) {
+    if (get_and_clear_channel_flag(lc_load_flags_, id)) {
       return get_reg(id, 3) >> 3 & 0b11111;
     } else {
       return 0xFF;
@@ -109,7 +121,7 @@ public:
     return is_pulse(id) && (get_reg(id, 1) & util::BIT7);
   }
   uint8_t sweepDivider(ChannelId id) {
-    if (get_and_clear_channel_flag(SweepReloadFlags, id)) {
+    if (get_and_clear_channel_flag(sweep_reload_flags_, id)) {
       return (get_reg(id, 1) >> 4) & 0b111;
     } else {
       return 0xFF;
@@ -118,9 +130,9 @@ public:
   bool sweepNegate(ChannelId id) { return get_reg(id, 1) & util::BIT3; }
   uint8_t sweepShift(ChannelId id) { return get_reg(id, 1) & 0b111; }
 
-  double dutyCycle(ChannelId id) {
+  uint8_t dutyMode(ChannelId id) {
     assert(is_pulse(id));
-    return calc_duty_cycle(get_reg(id, 0));
+    return (get_reg(id, 0) >> 6) & 0b11;
   }
 
   uint16_t generatorPeriod(ChannelId id) {
@@ -142,14 +154,9 @@ public:
 
   bool nsMode() const { return generator_regs[NS_LNP] & util::BIT7; }
 
-  double nsFreq() const {
-    uint8_t period = (generator_regs[NS_LNP] & 0b1111);
-    if (nsMode()) {
-      return 4811.2 / (1 << period);
-    } else {
-      static double cpu_freq = 1.789773e6;
-      return cpu_freq / (16 * (period + 1));
-    }
+  // in CPU cycles
+  uint16_t nsPeriod() const {
+    return NoisePeriodTable[generator_regs[NS_LNP] & 0b1111];
   }
 
   void setFcStatus(uint8_t s) { fc_status_ = s; }
@@ -177,8 +184,6 @@ public:
   }
 
 private:
-  double calc_duty_cycle(uint8_t val) const;
-
   using ChannelFlags = std::array<bool, static_cast<int>(ChannelId::NCID)>;
 
   void set_channel_flag(ChannelFlags &arr, ChannelId id) {
@@ -212,6 +217,7 @@ private:
   // frame counter
   uint8_t frame_control_reg_ = 0x00;
   bool fc_reset_ = false;
+  int fc_reset_delay_ = 0;
   uint8_t fc_status_ = 0x00;
   bool clear_frame_interrupt_ = false;
   uint8_t seq_mode_ = 0;
@@ -220,6 +226,7 @@ private:
   bool tr_lin_load_pending = true;
 
   bool dmc_en_changed = false;
+  uint8_t config_dirty_ = 0b1111;
   bool dmc_direct_load = false;
 
   std::array<uint8_t, CName::N_REGS> last_write_ = {0};
@@ -229,11 +236,15 @@ private:
       190, 160, 142, 128, 106, 84,  72,  54,
   };
 
+  static constexpr std::array<uint16_t, 0x10> NoisePeriodTable = {
+      4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068,
+  };
+
   static constexpr std::array<uint8_t, static_cast<size_t>(ChannelId::NCID)>
       GRegBase = {0x00, 0x04, 0x08, 0x0C, 0x10};
-  static ChannelFlags EnvStartFlags;
-  static ChannelFlags LcLoadFlags;
-  static ChannelFlags SweepReloadFlags;
+  ChannelFlags env_start_flags_ = {false, false, false, false, false};
+  ChannelFlags lc_load_flags_ = {true, true, true, true, false};
+  ChannelFlags sweep_reload_flags_ = {false, false, false, false, false};
 };
 
 } // namespace aud
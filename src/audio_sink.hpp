@@ -0,0 +1,88 @@
+#pragma once
+
+#include "sample_queue.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aud {
+
+// A 16 bit PCM WAV header for data_bytes of samples
+void WriteWavHeader(std::ostream &out, uint32_t sample_rate,
+                    uint16_t channels, uint32_t data_bytes);
+// The data size to put in the header for a number of 16 bit samples, which
+// saturates rather than wrapping past what WAV can describe
+uint32_t WavDataBytes(uint64_t samples);
+
+// Consumer end of the APU's output queue. Exactly one sink drains a given
+// queue (it's single consumer), from whatever thread suits it.
+class Sink {
+public:
+  virtual ~Sink() = default;
+
+  // Start draining q, which carries mono samples at sample_rate
+  virtual void open(SampleQueue &q, int sample_rate) = 0;
+
+  // Called on the emulation thread after each completed video frame
+  virtual void frame() {}
+
+  // Whether the sink drains in real time. If so, the APU steers its output
+  // rate to hold the queue at the target latency; otherwise the output rate
+  // stays fixed so the samples are reproducible.
+  virtual bool realtime() const { return false; }
+};
+
+// Discards samples, keeping an FNV-1a hash of each frame's worth so tests
+// can check audio for regressions.
+class NullSink : public Sink {
+public:
+  void open(SampleQueue &q, int sample_rate) override { q_ = &q; }
+  void frame() override;
+
+  const std::vector<uint64_t> &hashes() const { return hashes_; }
+  uint64_t samples() const { return samples_; }
+
+private:
+  static constexpr uint64_t FnvBasis = 0xCBF29CE484222325ull;
+  static constexpr uint64_t FnvPrime = 0x100000001B3ull;
+
+  SampleQueue *q_ = nullptr;
+  std::vector<int16_t> buf_ = std::vector<int16_t>(4096);
+  std::vector<uint64_t> hashes_;
+  uint64_t samples_ = 0;
+};
+
+// Streams samples to a 16 bit WAV file from a background thread, so disk
+// writes stay off the emulation thread. Multi-channel input arrives
+// interleaved, which is also how WAV lays it out.
+class WavSink : public Sink {
+public:
+  explicit WavSink(const std::string &path, uint16_t channels = 1);
+  ~WavSink();
+
+  void open(SampleQueue &q, int sample_rate) override;
+  void frame() override;
+  // Drain what's left, finish the header and close the file. Must happen
+  // before the queue goes away.
+  void close();
+
+private:
+  void run();
+  size_t drain();
+
+  std::ofstream out_;
+  SampleQueue *q_ = nullptr;
+  int sample_rate_ = 0;
+  uint16_t channels_;
+  std::vector<int16_t> buf_ = std::vector<int16_t>(4096);
+  uint64_t samples_ = 0;
+  std::atomic<bool> done_ = false;
+  std::thread writer_;
+};
+
+} // namespace aud
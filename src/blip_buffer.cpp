@@ -0,0 +1,90 @@
+#include "blip_buffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace aud {
+
+BlipBuffer::BlipBuffer(double clock_rate, int sample_rate, size_t max_samples)
+    : nominal_(sample_rate / clock_rate * (1ull << FracBits)),
+      factor_(static_cast<uint64_t>(std::llround(nominal_))),
+      sample_rate_(sample_rate), buf_(max_samples + Taps, 0.0f) {}
+
+void BlipBuffer::setRatio(double ratio) {
+  ratio_ = ratio;
+  factor_ = static_cast<uint64_t>(std::llround(nominal_ * ratio_));
+}
+
+void BlipBuffer::addDelta(uint32_t time, int32_t delta) {
+  uint64_t pos = offset_ + time * factor_;
+  size_t idx = pos >> FracBits;
+  int phase = (pos >> (FracBits - 5)) & (Phases - 1);
+  assert(idx + Taps <= buf_.size());
+  const auto &k = StepKernel()[phase];
+  float d = static_cast<float>(delta);
+  for (int i = 0; i < Taps; ++i) {
+    buf_[idx + i] += d * k[i];
+  }
+}
+
+void BlipBuffer::endFrame(uint32_t time) {
+  offset_ += time * factor_;
+  avail_ = offset_ >> FracBits;
+  assert(avail_ + Taps <= buf_.size());
+}
+
+size_t BlipBuffer::readSamples(float *out, size_t n) {
+  n = std::min(n, avail_);
+  for (size_t i = 0; i < n; ++i) {
+    integrator_ += buf_[i];
+    out[i] = integrator_;
+  }
+
+  std::copy(buf_.begin() + n, buf_.begin() + avail_ + Taps, buf_.begin());
+  std::fill(buf_.begin() + avail_ + Taps - n, buf_.begin() + avail_ + Taps,
+            0.0f);
+  avail_ -= n;
+  offset_ -= static_cast<uint64_t>(n) << FracBits;
+  return n;
+}
+
+void BlipBuffer::clear() {
+  std::fill(buf_.begin(), buf_.end(), 0.0f);
+  offset_ = 0;
+  avail_ = 0;
+  integrator_ = 0.0f;
+}
+
+// Windowed sinc impulses, one per sub-sample phase. Each phase is normalized
+// to sum to 1 so an integrated delta settles at exactly its amplitude.
+const BlipBuffer::Kernel &BlipBuffer::StepKernel() {
+  static const Kernel kernel = [] {
+    Kernel k = {};
+    // cut off a little below Nyquist to leave room for the transition band
+    constexpr double Cutoff = 0.45;
+    constexpr double Pi = 3.14159265358979323846;
+    for (int p = 0; p < Phases; ++p) {
+      double frac = static_cast<double>(p) / Phases;
+      double sum = 0.0;
+      for (int i = 0; i < Taps; ++i) {
+        double x = i - (Taps / 2 - 1) - frac;
+        double s = (x == 0.0) ? 2.0 * Cutoff
+                              : std::sin(2.0 * Pi * Cutoff * x) / (Pi * x);
+        // blackman window over [-Taps/2, Taps/2]
+        double w = (x + Taps / 2.0) / Taps;
+        double win = 0.42 - 0.5 * std::cos(2.0 * Pi * w) +
+                     0.08 * std::cos(4.0 * Pi * w);
+        k[p][i] = static_cast<float>(s * win);
+        sum += s * win;
+      }
+      for (int i = 0; i < Taps; ++i) {
+        k[p][i] = static_cast<float>(k[p][i] / sum);
+      }
+    }
+    return k;
+  }();
+  return kernel;
+}
+
+} // namespace aud
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace aud {
+
+static constexpr double CpuFreq = 1.789773e6;
+static constexpr int SampleRate = 48000;
+
+// Band-limited step synthesis.
+//
+// The APU reports each change in its output as an amplitude delta at the CPU
+// cycle where it happened. Every delta lands in the output as a windowed sinc
+// impulse at its exact (fractional) sample position, and reading integrates
+// those impulses back into a signal, so hard edges come out without aliasing
+// and resampling to the device rate falls out for free.
+//
+// Time is counted in CPU cycles from the start of the current frame. Call
+// endFrame() periodically to make the samples before that point readable.
+class BlipBuffer {
+public:
+  BlipBuffer(double clock_rate, int sample_rate, size_t max_samples);
+
+  void addDelta(uint32_t time, int32_t delta);
+  void endFrame(uint32_t time);
+
+  size_t samplesAvail() const { return avail_; }
+  // Integrate up to n finished samples into out. Returns the number written.
+  // The output carries the APU's DC offset; see OutputFilter.
+  size_t readSamples(float *out, size_t n);
+  void clear();
+
+  int sampleRate() const { return sample_rate_; }
+
+  // Stretch the output by a small factor, e.g. 1.002 emits 0.2% more samples
+  // per clock. Takes effect from the next delta.
+  void setRatio(double ratio);
+  double ratio() const { return ratio_; }
+
+private:
+  static constexpr int Taps = 16;
+  static constexpr int Phases = 32;
+  // fixed point sample position, FracBits below the binary point
+  static constexpr int FracBits = 20;
+  using Kernel = std::array<std::array<float, Taps>, Phases>;
+  static const Kernel &StepKernel();
+
+  double nominal_;
+  double ratio_ = 1.0;
+  uint64_t factor_;
+  uint64_t offset_ = 0;
+  int sample_rate_;
+  size_t avail_ = 0;
+  float integrator_ = 0.0f;
+  std::vector<float> buf_;
+};
+
+} // namespace aud
@@ -0,0 +1,206 @@
+#include "capture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace sys {
+
+namespace {
+// 236.25MHz / 11 / 357366, the NTSC frame rate in lowest terms
+constexpr uint64_t RateNum = 39375000;
+constexpr uint64_t RateDen = 655171;
+
+std::ofstream openOut(const std::string &path) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("Couldn't open " + path + " for writing");
+  }
+  return out;
+}
+} // namespace
+
+Capture::Capture(const vid::FrameQueue &frames,
+                 std::span<const vid::Rgb, 512> palette,
+                 const std::string &base, Format format)
+    : frames_(frames), format_(format),
+      video_(openOut(base + (format == Format::Y4m ? ".y4m" : ".nesv"))),
+      wav_(openOut(base + ".wav")) {
+  for (size_t p = 0; p < palette.size(); ++p) {
+    int r = palette[p][0];
+    int g = palette[p][1];
+    int b = palette[p][2];
+    yuv_[p] = {
+        static_cast<uint8_t>(16 + (66 * r + 129 * g + 25 * b + 128) / 256),
+        static_cast<uint8_t>(128 + (-38 * r - 74 * g + 112 * b + 128) / 256),
+        static_cast<uint8_t>(128 + (112 * r - 94 * g - 18 * b + 128) / 256),
+    };
+  }
+
+  if (format_ == Format::Y4m) {
+    video_ << "YUV4MPEG2 W" << vid::WIDTH << " H" << vid::HEIGHT << " F"
+           << RateNum << ":" << RateDen << " Ip A8:7 C420jpeg\n";
+  } else {
+    auto pal = openOut(base + ".pal");
+    for (auto &rgb : palette) {
+      pal.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
+    }
+  }
+
+  for (uint32_t i = 0; i < Slots; ++i) {
+    free_.push(i);
+  }
+}
+
+Capture::~Capture() { close(); }
+
+void Capture::open(aud::SampleQueue &q, int sample_rate) {
+  if (q_ != nullptr) {
+    throw std::runtime_error("Capture already open");
+  }
+  q_ = &q;
+  sample_rate_ = sample_rate;
+  // room for everything the queue can hold, which is what may have built up
+  // over a run of dropped frames
+  for (auto &slot : slots_) {
+    slot.samples.resize(q.capacity());
+  }
+  // sizes are patched in on close
+  aud::WriteWavHeader(wav_, sample_rate_, 1, 0);
+  writer_ = std::thread(&Capture::run, this);
+}
+
+void Capture::frame() {
+  if (q_ == nullptr) {
+    return;
+  }
+  auto index = free_.pop();
+  if (!index) {
+    // NOTE(oren): leave the samples queued for the next frame that makes it.
+    // If drops run on long enough to fill the sample queue, it drops (and
+    // counts) the overflow itself.
+    ++skipped_;
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto &slot = slots_[*index];
+  auto pixels = frames_.latest();
+  std::copy(pixels.begin(), pixels.end(), slot.pixels.begin());
+  slot.count = q_->pop(slot.samples.data(), slot.samples.size());
+  slot.skipped = skipped_;
+  skipped_ = 0;
+  full_.push(*index);
+
+  auto queued = full_.size();
+  if (queued > max_queued_.load(std::memory_order_relaxed)) {
+    max_queued_.store(queued, std::memory_order_relaxed);
+  }
+}
+
+void Capture::close() {
+  if (q_ == nullptr) {
+    return;
+  }
+  done_ = true;
+  writer_.join();
+
+  // NOTE(oren): frames dropped at the very end have no later frame to stand
+  // in for them or carry their audio, so repeat the last one written for
+  // each and flush what's left queued. The writer's done with the slots.
+  if (skipped_ > 0) {
+    if (!out_.empty()) {
+      for (; skipped_ > 0; --skipped_) {
+        writeFrame();
+      }
+    }
+    auto &rest = slots_[0].samples;
+    auto n = q_->pop(rest.data(), rest.size());
+    wav_.write(reinterpret_cast<const char *>(rest.data()),
+               n * sizeof(int16_t));
+    samples_.fetch_add(n, std::memory_order_relaxed);
+    skipped_ = 0;
+  }
+
+  wav_.seekp(0);
+  aud::WriteWavHeader(wav_, sample_rate_, 1, aud::WavDataBytes(samples_));
+  wav_.close();
+  video_.close();
+  q_ = nullptr;
+}
+
+Capture::Stats Capture::stats() const {
+  return {
+      .frames = written_.load(std::memory_order_relaxed),
+      .dropped = dropped_.load(std::memory_order_relaxed),
+      .max_queued = max_queued_.load(std::memory_order_relaxed),
+      .samples = samples_.load(std::memory_order_relaxed),
+  };
+}
+
+void Capture::run() {
+  while (true) {
+    auto index = full_.pop();
+    if (!index) {
+      if (done_) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      continue;
+    }
+    write(slots_[*index]);
+    free_.push(*index);
+  }
+}
+
+void Capture::write(const Slot &slot) {
+  if (!out_.empty()) {
+    for (uint64_t i = 0; i < slot.skipped; ++i) {
+      writeFrame();
+    }
+  }
+
+  if (format_ == Format::Y4m) {
+    // full resolution luma, then each chroma plane averaged over 2x2 blocks
+    constexpr size_t W = vid::WIDTH;
+    constexpr size_t H = vid::HEIGHT;
+    out_.resize(W * H * 3 / 2);
+    auto luma = out_.data();
+    auto cb = luma + W * H;
+    auto cr = cb + W * H / 4;
+    for (size_t i = 0; i < W * H; ++i) {
+      luma[i] = yuv_[slot.pixels[i] & 0x1FF][0];
+    }
+    for (size_t y = 0; y < H; y += 2) {
+      for (size_t x = 0; x < W; x += 2) {
+        const vid::Pixel *p = slot.pixels.data() + y * W + x;
+        auto &a = yuv_[p[0] & 0x1FF];
+        auto &b = yuv_[p[1] & 0x1FF];
+        auto &c = yuv_[p[W] & 0x1FF];
+        auto &d = yuv_[p[W + 1] & 0x1FF];
+        size_t o = (y / 2) * (W / 2) + x / 2;
+        cb[o] = static_cast<uint8_t>((a[1] + b[1] + c[1] + d[1] + 2) / 4);
+        cr[o] = static_cast<uint8_t>((a[2] + b[2] + c[2] + d[2] + 2) / 4);
+      }
+    }
+  } else {
+    // little endian, as is everything we build for
+    auto bytes = reinterpret_cast<const uint8_t *>(slot.pixels.data());
+    out_.assign(bytes, bytes + sizeof(slot.pixels));
+  }
+  writeFrame();
+
+  wav_.write(reinterpret_cast<const char *>(slot.samples.data()),
+             slot.count * sizeof(int16_t));
+  samples_.fetch_add(slot.count, std::memory_order_relaxed);
+}
+
+void Capture::writeFrame() {
+  if (format_ == Format::Y4m) {
+    video_ << "FRAME\n";
+  }
+  video_.write(reinterpret_cast<const char *>(out_.data()), out_.size());
+  written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace sys
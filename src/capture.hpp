@@ -0,0 +1,109 @@
+#pragma once
+
+#include "audio_sink.hpp"
+#include "frame_queue.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sys {
+
+// Records a session's video and audio, for QA runs too long to watch live.
+//
+// Takes the place of the audio sink. After each frame, on the emulation
+// thread, the frame's raw 9 bit pixels and the audio synthesized with it are
+// copied into one of a fixed set of slots and queued for a background
+// thread, which converts and writes them. Nothing on the emulation side
+// waits: when the writer falls behind far enough that every slot is taken,
+// frames are dropped and counted. The writer repeats the last frame in their
+// place (their audio rides along with the next frame), so picture and sound
+// stay in step.
+class Capture : public aud::Sink {
+public:
+  enum class Format {
+    // base.y4m (4:2:0, 8:7 pixels, at the NTSC frame rate) and base.wav
+    Y4m,
+    // base.nesv, each frame's raw pixels as little endian 16 bit words
+    // (palette index in bits 0-5, emphasis in bits 6-8), base.pal, the 512
+    // colors as RGB triples, and base.wav
+    Raw,
+  };
+
+  struct Stats {
+    // frames written, including repeats standing in for dropped ones
+    uint64_t frames = 0;
+    // frames dropped because every slot was queued
+    uint64_t dropped = 0;
+    // most slots queued at once, out of Slots
+    size_t max_queued = 0;
+    uint64_t samples = 0;
+  };
+
+  // NOTE(oren): a little over 2 seconds of frames, 15MB of pixels
+  static constexpr size_t Slots = 128;
+
+  // frames is the console's queue; each frame is read from it as soon as
+  // it's published. palette converts pixels to RGB (PPU::FullPalette).
+  Capture(const vid::FrameQueue &frames,
+          std::span<const vid::Rgb, 512> palette, const std::string &base,
+          Format format);
+  ~Capture();
+
+  void open(aud::SampleQueue &q, int sample_rate) override;
+  void frame() override;
+  // Write out everything queued, repeats for any frames dropped at the end
+  // included, and close the files. Must happen before the sample queue goes
+  // away.
+  void close();
+
+  // Safe to call from any thread while capturing
+  Stats stats() const;
+
+private:
+  struct Slot {
+    vid::FrameBuffer pixels;
+    std::vector<int16_t> samples;
+    size_t count = 0;
+    // frames dropped just before this one
+    uint64_t skipped = 0;
+  };
+
+  void run();
+  void write(const Slot &slot);
+  void writeFrame();
+
+  const vid::FrameQueue &frames_;
+  Format format_;
+  std::ofstream video_;
+  std::ofstream wav_;
+  aud::SampleQueue *q_ = nullptr;
+  int sample_rate_ = 0;
+
+  std::vector<Slot> slots_ = std::vector<Slot>(Slots);
+  // empty slots, back from the writer, and full ones on their way to it
+  util::SpscQueue<uint32_t, Slots> free_;
+  util::SpscQueue<uint32_t, Slots> full_;
+  uint64_t skipped_ = 0;
+
+  // the last frame as written, to repeat for dropped ones
+  std::vector<uint8_t> out_;
+  // BT.601 studio range, per pixel value
+  std::array<std::array<uint8_t, 3>, 512> yuv_ = {};
+
+  std::atomic<uint64_t> written_ = 0;
+  std::atomic<uint64_t> dropped_ = 0;
+  std::atomic<size_t> max_queued_ = 0;
+  std::atomic<uint64_t> samples_ = 0;
+  std::atomic<bool> done_ = false;
+  std::thread writer_;
+};
+
+} // namespace sys
@@ -1,13 +1,106 @@
 #pragma once
 
+#include "dbg/expression.hpp"
 #include "instruction.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <iomanip>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace sys {
 
+// A whole string as hex, with an optional leading '$', no larger than max
+inline uint32_t ParseHex(std::string_view s, uint32_t max) {
+  std::string_view digits = s.substr(!s.empty() && s[0] == '$' ? 1 : 0);
+  uint32_t v = 0;
+  auto [end, ec] =
+      std::from_chars(digits.data(), digits.data() + digits.size(), v, 16);
+  if (digits.empty() || ec != std::errc() ||
+      end != digits.data() + digits.size() || v > max) {
+    throw std::invalid_argument("Bad hex value '" + std::string(s) + "'");
+  }
+  return v;
+}
+
+// Flat bitmap over an address space. Lookups are a shift and a mask, so cost
+// doesn't depend on how many addresses are marked.
+class AddressMap {
+public:
+  explicit AddressMap(size_t n = 0) { resize(n); }
+
+  void resize(size_t n) {
+    size_ = n;
+    bits_.assign((n + 63) >> 6, 0);
+    count_ = 0;
+  }
+
+  void clear() {
+    std::fill(bits_.begin(), bits_.end(), 0);
+    count_ = 0;
+  }
+
+  void set(size_t a) {
+    if (a < size_ && !test(a)) {
+      bits_[a >> 6] |= (1ull << (a & 63));
+      ++count_;
+    }
+  }
+
+  bool test(size_t a) const {
+    return a < size_ && ((bits_[a >> 6] >> (a & 63)) & 0b1);
+  }
+
+  // true if any address in [base, base + 256) is marked
+  bool testPage(size_t base) const {
+    for (size_t w = base >> 6; w < ((base + 0x100) >> 6) && w < bits_.size();
+         ++w) {
+      if (bits_[w]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool empty() const { return count_ == 0; }
+  size_t count() const { return count_; }
+
+private:
+  std::vector<uint64_t> bits_;
+  size_t size_ = 0;
+  size_t count_ = 0;
+};
+
+class Breakpoint;
+
+struct BreakMaps {
+  AddressMap pc{0x10000};
+  // PCs with a condition attached, evaluated only when one is reached
+  AddressMap guarded{0x10000};
+  std::unordered_multimap<uint16_t, const Breakpoint *> at_pc;
+  // indexed by PRG ROM offset, so a breakpoint only fires in one bank
+  AddressMap prg;
+  AddressMap read{0x10000};
+  AddressMap write{0x10000};
+
+  void clear() {
+    pc.clear();
+    guarded.clear();
+    at_pc.clear();
+    prg.clear();
+    read.clear();
+    write.clear();
+  }
+};
+
 class Breakpoint {
 public:
   Breakpoint() = default;
@@ -17,6 +110,15 @@ public:
   virtual bool isEnabled() const = 0;
   virtual bool check(const instr::Instruction &in) const = 0;
   virtual std::string str() const = 0;
+  // Mark this breakpoint in the debugger's address maps. Returns false if it
+  // can't be indexed by address and needs check() on every instruction.
+  virtual bool arm(BreakMaps &maps) const { return false; }
+  // Full check with machine state available. Only conditional breakpoints
+  // and tracepoints need more than the instruction.
+  virtual bool evaluate(const instr::Instruction &in,
+                        const ExprContext &ctx) const {
+    return check(in);
+  }
 };
 
 template <typename Derived> class BpBase : public Breakpoint {
@@ -46,6 +148,11 @@ public:
   PcBreakpoint(bool e, uint16_t pc) : Parent(e), pc_(pc) {}
   bool check_impl(const instr::Instruction &in) const { return in.pc == pc_; }
 
+  bool arm(BreakMaps &maps) const override {
+    maps.pc.set(pc_);
+    return true;
+  }
+
   std::string str() const override {
     std::stringstream ss;
     ss << "0x" << std::hex << std::setw(4) << pc_;
@@ -70,4 +177,243 @@ private:
   uint8_t opcode_;
 };
 
+// Break on a PC only while a particular PRG bank is mapped in, identified by
+// the PRG ROM offset the PC resolves to.
+class PrgBreakpoint : public BpBase<PrgBreakpoint> {
+  using Parent = BpBase<PrgBreakpoint>;
+
+public:
+  PrgBreakpoint(bool e, uint32_t offset) : Parent(e), offset_(offset) {}
+  // offset in hex, e.g. "1C010"
+  PrgBreakpoint(bool e, const std::string &spec)
+      : Parent(e), offset_(ParseHex(spec, 0xFFFFFF)) {}
+
+  // resolved through the address maps only
+  bool check_impl(const instr::Instruction &in) const { return false; }
+
+  bool arm(BreakMaps &maps) const override {
+    maps.prg.set(offset_);
+    return true;
+  }
+
+  std::string str() const override {
+    std::stringstream ss;
+    ss << "PRG 0x" << std::hex << std::setw(6) << offset_;
+    return ss.str();
+  }
+
+private:
+  uint32_t offset_;
+};
+
+class Watchpoint : public BpBase<Watchpoint> {
+  using Parent = BpBase<Watchpoint>;
+
+public:
+  enum Access : uint8_t {
+    READ = 0b001,
+    WRITE = 0b010,
+    EXEC = 0b100,
+  };
+
+  Watchpoint(bool e, uint16_t addr, uint16_t len, uint8_t access)
+      : Parent(e), addr_(addr), len_(len), access_(access) {}
+
+  // Any of r, w and x, then an address or an inclusive range in hex,
+  // e.g. "w:0300" or "rw:6000-7FFF"
+  Watchpoint(bool e, const std::string &spec) : Parent(e) {
+    auto colon = spec.find(':');
+    if (colon == 0 || colon == std::string::npos) {
+      throw std::invalid_argument("Bad watchpoint '" + spec + "'");
+    }
+    access_ = 0;
+    for (char c : spec.substr(0, colon)) {
+      switch (std::tolower(static_cast<unsigned char>(c))) {
+      case 'r':
+        access_ |= READ;
+        break;
+      case 'w':
+        access_ |= WRITE;
+        break;
+      case 'x':
+        access_ |= EXEC;
+        break;
+      default:
+        throw std::invalid_argument("Bad watchpoint access '" + spec + "'");
+      }
+    }
+    std::string_view range(spec);
+    range.remove_prefix(colon + 1);
+    auto dash = range.find('-');
+    addr_ = ParseHex(range.substr(0, dash), 0xFFFF);
+    uint32_t last = addr_;
+    if (dash != std::string_view::npos) {
+      last = ParseHex(range.substr(dash + 1), 0xFFFF);
+    }
+    if (last < addr_) {
+      throw std::invalid_argument("Empty watchpoint range '" + spec + "'");
+    }
+    len_ = last - addr_ + 1;
+  }
+
+  // resolved through the address maps only
+  bool check_impl(const instr::Instruction &in) const { return false; }
+
+  bool arm(BreakMaps &maps) const override {
+    for (uint32_t a = addr_; a < addr_ + len_; ++a) {
+      if (access_ & READ) {
+        maps.read.set(a);
+      }
+      if (access_ & WRITE) {
+        maps.write.set(a);
+      }
+      if (access_ & EXEC) {
+        maps.pc.set(a);
+      }
+    }
+    return true;
+  }
+
+  std::string str() const override {
+    std::stringstream ss;
+    ss << ((access_ & READ) ? "R" : "-") << ((access_ & WRITE) ? "W" : "-")
+       << ((access_ & EXEC) ? "X" : "-") << " 0x" << std::hex << std::setw(4)
+       << addr_;
+    if (len_ > 1) {
+      ss << "-0x" << std::setw(4) << (addr_ + len_ - 1);
+    }
+    return ss.str();
+  }
+
+private:
+  uint16_t addr_;
+  // up to 0x10000, the whole address space
+  uint32_t len_;
+  uint8_t access_;
+};
+
+// Break when an expression is true, optionally only at one PC. Without a PC
+// the expression is evaluated before every instruction.
+class CondBreakpoint : public BpBase<CondBreakpoint> {
+  using Parent = BpBase<CondBreakpoint>;
+
+public:
+  CondBreakpoint(bool e, std::optional<uint16_t> pc, const std::string &cond)
+      : Parent(e), pc_(pc), expr_(cond) {}
+
+  // needs machine state, see evaluate()
+  bool check_impl(const instr::Instruction &in) const { return false; }
+
+  bool evaluate(const instr::Instruction &in,
+                const ExprContext &ctx) const override {
+    return isEnabled() && expr_.eval(ctx) != 0;
+  }
+
+  bool arm(BreakMaps &maps) const override {
+    if (!pc_) {
+      return false;
+    }
+    maps.guarded.set(*pc_);
+    maps.at_pc.emplace(*pc_, this);
+    return true;
+  }
+
+  std::string str() const override {
+    std::stringstream ss;
+    if (pc_) {
+      ss << "0x" << std::hex << std::setw(4) << *pc_ << ": ";
+    }
+    ss << "if " << expr_.str();
+    return ss.str();
+  }
+
+private:
+  std::optional<uint16_t> pc_;
+  Expression expr_;
+};
+
+// Print a line instead of breaking. The format is literal text with `{expr}`
+// fields, printed in hex, or in decimal as `{expr:d}`.
+//   e.g. "A={A} Y={Y} ptr={[$01] << 8 | [$00]} sl={scanline:d}"
+class Tracepoint : public BpBase<Tracepoint> {
+  using Parent = BpBase<Tracepoint>;
+
+public:
+  Tracepoint(bool e, std::optional<uint16_t> pc, const std::string &fmt)
+      : Parent(e), pc_(pc), fmt_(fmt) {
+    size_t i = 0;
+    while (i < fmt.size()) {
+      auto open = fmt.find('{', i);
+      if (open == std::string::npos) {
+        fields_.push_back({fmt.substr(i), std::nullopt, false});
+        break;
+      }
+      auto close = fmt.find('}', open);
+      if (close == std::string::npos) {
+        throw std::invalid_argument("Unterminated '{' in '" + fmt + "'");
+      }
+      auto src = fmt.substr(open + 1, close - open - 1);
+      bool dec = false;
+      if (src.size() > 2 && src.compare(src.size() - 2, 2, ":d") == 0) {
+        dec = true;
+        src.resize(src.size() - 2);
+      }
+      fields_.push_back({fmt.substr(i, open - i), Expression(src), dec});
+      i = close + 1;
+    }
+  }
+
+  bool check_impl(const instr::Instruction &in) const { return false; }
+
+  bool evaluate(const instr::Instruction &in,
+                const ExprContext &ctx) const override {
+    if (!isEnabled()) {
+      return false;
+    }
+    ctx.trace << "TRACE 0x" << std::hex << std::setw(4) << std::setfill('0')
+              << in.pc << ": ";
+    for (const auto &f : fields_) {
+      ctx.trace << f.text;
+      if (f.expr) {
+        if (f.dec) {
+          ctx.trace << std::dec << f.expr->eval(ctx);
+        } else {
+          ctx.trace << std::hex << f.expr->eval(ctx);
+        }
+      }
+    }
+    ctx.trace << std::dec << std::setfill(' ') << "\n";
+    return false;
+  }
+
+  bool arm(BreakMaps &maps) const override {
+    if (!pc_) {
+      return false;
+    }
+    maps.guarded.set(*pc_);
+    maps.at_pc.emplace(*pc_, this);
+    return true;
+  }
+
+  std::string str() const override {
+    std::stringstream ss;
+    if (pc_) {
+      ss << "0x" << std::hex << std::setw(4) << *pc_ << ": ";
+    }
+    ss << "trace \"" << fmt_ << "\"";
+    return ss.str();
+  }
+
+private:
+  struct Field {
+    std::string text;
+    std::optional<Expression> expr;
+    bool dec;
+  };
+
+  std::optional<uint16_t> pc_;
+  std::string fmt_;
+  std::vector<Field> fields_;
+};
+
 } // namespace sys
@@ -0,0 +1,435 @@
+#include "dbg/expression.hpp"
+#include "mappers/base_mapper.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace sys {
+
+namespace {
+
+struct Token {
+  enum Kind {
+    NUM,
+    IDENT,
+    OP,
+    END,
+  };
+  Kind kind;
+  std::string text;
+  int32_t value = 0;
+};
+
+// longest match first
+const std::array<const char *, 24> Punct = {
+    "||", "&&", "==", "!=", "<=", ">=", "<<", ">>", "<", ">", "+", "-",
+    "*",  "/",  "%",  "&",  "|",  "^",  "!",  "~",  "(", ")", "[", "]",
+};
+
+std::vector<Token> tokenize(const std::string &src) {
+  std::vector<Token> result;
+  size_t i = 0;
+  while (i < src.size()) {
+    char c = src[i];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++i;
+      continue;
+    }
+
+    // '%' is a binary literal prefix only where an operand is expected
+    bool operand = result.empty() || (result.back().kind == Token::OP &&
+                                      result.back().text != ")" &&
+                                      result.back().text != "]");
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '$' ||
+        (c == '%' && operand)) {
+      int base = 10;
+      size_t start = i;
+      if (c == '$') {
+        base = 16;
+        start = ++i;
+      } else if (c == '%') {
+        base = 2;
+        start = ++i;
+      } else if (c == '0' && i + 1 < src.size() &&
+                 (src[i + 1] == 'x' || src[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+        start = i;
+      }
+      while (i < src.size() &&
+             std::isxdigit(static_cast<unsigned char>(src[i]))) {
+        ++i;
+      }
+      auto digits = src.substr(start, i - start);
+      if (digits.empty()) {
+        throw std::invalid_argument("Malformed number in '" + src + "'");
+      }
+      // anything that fits in 32 bits, e.g. $FFFFFFFF for -1
+      uint32_t v = 0;
+      auto [end, ec] = std::from_chars(digits.data(),
+                                       digits.data() + digits.size(), v, base);
+      if (ec == std::errc::result_out_of_range) {
+        throw std::invalid_argument("Number out of range '" + digits + "'");
+      } else if (ec != std::errc() || end != digits.data() + digits.size()) {
+        throw std::invalid_argument("Malformed number '" + digits + "'");
+      }
+      result.push_back({Token::NUM, digits, static_cast<int32_t>(v)});
+      continue;
+    }
+
+    if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+      size_t start = i;
+      while (i < src.size() &&
+             (std::isalnum(static_cast<unsigned char>(src[i])) ||
+              src[i] == '_')) {
+        ++i;
+      }
+      result.push_back({Token::IDENT, src.substr(start, i - start)});
+      continue;
+    }
+
+    bool matched = false;
+    for (const auto *p : Punct) {
+      if (src.compare(i, std::char_traits<char>::length(p), p) == 0) {
+        result.push_back({Token::OP, p});
+        i += std::char_traits<char>::length(p);
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) {
+      throw std::invalid_argument("Unexpected '" + std::string(1, c) +
+                                  "' in '" + src + "'");
+    }
+  }
+  result.push_back({Token::END, ""});
+  return result;
+}
+
+} // namespace
+
+struct Expression::Parser {
+  Parser(const std::string &src, std::vector<Instr> &code)
+      : src_(src), toks_(tokenize(src)), code_(code) {}
+
+  void parse() {
+    binary(0);
+    if (peek().kind != Token::END) {
+      fail("trailing '" + peek().text + "'");
+    }
+  }
+
+private:
+  struct BinOp {
+    const char *tok;
+    Op op;
+  };
+
+  // lowest to highest precedence
+  static const std::array<std::vector<BinOp>, 10> Levels;
+  static const std::unordered_map<std::string, Op> Operands;
+
+  const Token &peek() const { return toks_[pos_]; }
+  const Token &next() { return toks_[pos_++]; }
+  bool accept(const char *op) {
+    if (peek().kind == Token::OP && peek().text == op) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+  void expect(const char *op) {
+    if (!accept(op)) {
+      fail(std::string("expected '") + op + "'");
+    }
+  }
+
+  [[noreturn]] void fail(const std::string &why) {
+    throw std::invalid_argument("Bad expression '" + src_ + "': " + why);
+  }
+
+  void emit(Op op, int32_t arg = 0) {
+    switch (op) {
+    case Op::CONST:
+    case Op::REG_A:
+    case Op::REG_X:
+    case Op::REG_Y:
+    case Op::REG_SP:
+    case Op::REG_P:
+    case Op::REG_PC:
+    case Op::SCANLINE:
+    case Op::DOT:
+    case Op::BANK:
+    case Op::MEM:
+      ++depth_;
+      break;
+    case Op::DEREF:
+    case Op::NEG:
+    case Op::NOT:
+    case Op::INV:
+      break;
+    default:
+      --depth_;
+      break;
+    }
+    if (depth_ > MaxDepth) {
+      fail("nested too deeply");
+    }
+    code_.push_back({op, arg});
+  }
+
+  void binary(size_t level) {
+    if (level == Levels.size()) {
+      unary();
+      return;
+    }
+    binary(level + 1);
+    bool more = true;
+    while (more) {
+      more = false;
+      for (const auto &b : Levels[level]) {
+        if (accept(b.tok)) {
+          binary(level + 1);
+          emit(b.op);
+          more = true;
+          break;
+        }
+      }
+    }
+  }
+
+  void unary() {
+    if (accept("-")) {
+      unary();
+      emit(Op::NEG);
+    } else if (accept("!")) {
+      unary();
+      emit(Op::NOT);
+    } else if (accept("~")) {
+      unary();
+      emit(Op::INV);
+    } else {
+      primary();
+    }
+  }
+
+  void primary() {
+    const auto &t = next();
+    if (t.kind == Token::NUM) {
+      emit(Op::CONST, t.value);
+    } else if (t.kind == Token::IDENT) {
+      std::string id;
+      for (char c : t.text) {
+        id.push_back(std::tolower(static_cast<unsigned char>(c)));
+      }
+      auto it = Operands.find(id);
+      if (it == Operands.end()) {
+        fail("unknown operand '" + t.text + "'");
+      }
+      emit(it->second);
+    } else if (t.kind == Token::OP && t.text == "(") {
+      binary(0);
+      expect(")");
+    } else if (t.kind == Token::OP && t.text == "[") {
+      auto start = code_.size();
+      binary(0);
+      expect("]");
+      if (code_.size() == start + 1 && code_.back().op == Op::CONST) {
+        // constant address, read it directly
+        code_.back().op = Op::MEM;
+        code_.back().arg &= 0xFFFF;
+      } else {
+        emit(Op::DEREF);
+      }
+    } else {
+      fail("unexpected '" + t.text + "'");
+    }
+  }
+
+  const std::string &src_;
+  std::vector<Token> toks_;
+  std::vector<Instr> &code_;
+  size_t pos_ = 0;
+  int depth_ = 0;
+};
+
+const std::array<std::vector<Expression::Parser::BinOp>, 10>
+    Expression::Parser::Levels = {{
+        {{"||", Op::LOR}},
+        {{"&&", Op::LAND}},
+        {{"|", Op::OR}},
+        {{"^", Op::XOR}},
+        {{"&", Op::AND}},
+        {{"==", Op::EQ}, {"!=", Op::NE}},
+        {{"<=", Op::LE}, {">=", Op::GE}, {"<", Op::LT}, {">", Op::GT}},
+        {{"<<", Op::SHL}, {">>", Op::SHR}},
+        {{"+", Op::ADD}, {"-", Op::SUB}},
+        {{"*", Op::MUL}, {"/", Op::DIV}, {"%", Op::MOD}},
+    }};
+
+const std::unordered_map<std::string, Expression::Op>
+    Expression::Parser::Operands = {
+        {"a", Op::REG_A},          {"x", Op::REG_X},
+        {"y", Op::REG_Y},          {"sp", Op::REG_SP},
+        {"s", Op::REG_SP},         {"p", Op::REG_P},
+        {"pc", Op::REG_PC},        {"scanline", Op::SCANLINE},
+        {"dot", Op::DOT},          {"cycle", Op::DOT},
+        {"bank", Op::BANK},
+};
+
+Expression::Expression(const std::string &src) : src_(src) {
+  Parser(src_, code_).parse();
+}
+
+int32_t Expression::eval(const ExprContext &ctx) const {
+  std::array<int32_t, MaxDepth> stack;
+  int sp = 0;
+  for (const auto &in : code_) {
+    switch (in.op) {
+    case Op::CONST:
+      stack[sp++] = in.arg;
+      break;
+    case Op::REG_A:
+      stack[sp++] = ctx.cpu.rA;
+      break;
+    case Op::REG_X:
+      stack[sp++] = ctx.cpu.rX;
+      break;
+    case Op::REG_Y:
+      stack[sp++] = ctx.cpu.rY;
+      break;
+    case Op::REG_SP:
+      stack[sp++] = ctx.cpu.sp;
+      break;
+    case Op::REG_P:
+      stack[sp++] = ctx.cpu.status;
+      break;
+    case Op::REG_PC:
+      stack[sp++] = ctx.cpu.pc;
+      break;
+    case Op::SCANLINE:
+      stack[sp++] = ctx.scanline;
+      break;
+    case Op::DOT:
+      stack[sp++] = ctx.dot;
+      break;
+    case Op::BANK: {
+      auto off = ctx.mapper.prgRomOffset(ctx.cpu.pc);
+      stack[sp++] = off < 0 ? -1 : (off >> 13);
+    } break;
+    case Op::MEM:
+      stack[sp++] = ctx.mapper.read(static_cast<uint16_t>(in.arg), true);
+      break;
+    case Op::DEREF:
+      stack[sp - 1] =
+          ctx.mapper.read(static_cast<uint16_t>(stack[sp - 1]), true);
+      break;
+    case Op::NEG:
+      stack[sp - 1] =
+          static_cast<int32_t>(-static_cast<uint32_t>(stack[sp - 1]));
+      break;
+    case Op::NOT:
+      stack[sp - 1] = !stack[sp - 1];
+      break;
+    case Op::INV:
+      stack[sp - 1] = ~stack[sp - 1];
+      break;
+    default: {
+      int32_t b = stack[--sp];
+      int32_t &a = stack[sp - 1];
+      // NOTE(oren): these are user input, so signed overflow and shifting
+      // negative values (both undefined) go through uint32_t and wrap
+      switch (in.op) {
+      case Op::MUL:
+        a = static_cast<int32_t>(static_cast<uint32_t>(a) *
+                                 static_cast<uint32_t>(b));
+        break;
+      case Op::DIV:
+        // INT32_MIN / -1 overflows too
+        a = (b == 0    ? 0
+             : b == -1 ? static_cast<int32_t>(-static_cast<uint32_t>(a))
+                       : a / b);
+        break;
+      case Op::MOD:
+        a = (b == 0 || b == -1 ? 0 : a % b);
+        break;
+      case Op::ADD:
+        a = static_cast<int32_t>(static_cast<uint32_t>(a) +
+                                 static_cast<uint32_t>(b));
+        break;
+      case Op::SUB:
+        a = static_cast<int32_t>(static_cast<uint32_t>(a) -
+                                 static_cast<uint32_t>(b));
+        break;
+      case Op::SHL:
+        a = static_cast<int32_t>(static_cast<uint32_t>(a) << (b & 31));
+        break;
+      case Op::SHR:
+        a = a >> (b & 31);
+        break;
+      case Op::LT:
+        a = a < b;
+        break;
+      case Op::LE:
+        a = a <= b;
+        break;
+      case Op::GT:
+        a = a > b;
+        break;
+      case Op::GE:
+        a = a >= b;
+        break;
+      case Op::EQ:
+        a = a == b;
+        break;
+      case Op::NE:
+        a = a != b;
+        break;
+      case Op::AND:
+        a = a & b;
+        break;
+      case Op::XOR:
+        a = a ^ b;
+        break;
+      case Op::OR:
+        a = a | b;
+        break;
+      case Op::LAND:
+        a = a && b;
+        break;
+      case Op::LOR:
+        a = a || b;
+        break;
+      default:
+        assert(false);
+      }
+    } break;
+    }
+  }
+  assert(sp == 1);
+  return stack[0];
+}
+
+std::optional<uint16_t> Expression::SplitPc(std::string &spec) {
+  auto colon = spec.find(':');
+  if (colon == std::string::npos) {
+    return std::nullopt;
+  }
+  size_t start = (spec[0] == '$') ? 1 : 0;
+  if (colon == start || colon - start > 4 ||
+      !std::all_of(spec.begin() + start, spec.begin() + colon, [](char c) {
+        return std::isxdigit(static_cast<unsigned char>(c));
+      })) {
+    // the colon belongs to the rest of the spec, e.g. "{scanline:d}"
+    return std::nullopt;
+  }
+  auto pc = std::stoi(spec.substr(start, colon - start), nullptr, 16);
+  spec = spec.substr(colon + 1);
+  return static_cast<uint16_t>(pc);
+}
+
+} // namespace sys
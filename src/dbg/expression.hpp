@@ -0,0 +1,102 @@
+#pragma once
+
+#include "cpu.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mapper {
+class NESMapper;
+}
+
+namespace sys {
+
+// Everything an expression can observe at an instruction boundary. The
+// debugger builds one of these on the stack for each instruction.
+struct ExprContext {
+  const cpu::CpuState &cpu;
+  mapper::NESMapper &mapper;
+  uint16_t scanline;
+  uint16_t dot;
+  std::ostream &trace;
+};
+
+// Debugger expressions, e.g. `A == $3F && [$00FF] > 4 && scanline >= 200`.
+//
+// Operands:
+//   A, X, Y, SP, P, PC    CPU registers
+//   scanline, dot         PPU position (`cycle` is an alias for dot)
+//   bank                  8KiB PRG ROM bank that PC maps to (-1 if none)
+//   [expr]                byte at a CPU address (side-effect free read)
+//   $FF, 0xFF, %1010, 255 literals
+//
+// C operator set and precedence, minus assignment and the ternary.
+//
+// The source is parsed once into postfix bytecode with typed operands.
+// eval() runs it on a fixed-size stack and never allocates.
+class Expression {
+public:
+  explicit Expression(const std::string &src);
+
+  int32_t eval(const ExprContext &ctx) const;
+  const std::string &str() const { return src_; }
+
+  // Split a "[PC:]rest" spec as used on the command line. Returns the PC if
+  // one was given and leaves the remainder in `spec`.
+  static std::optional<uint16_t> SplitPc(std::string &spec);
+
+private:
+  static constexpr int MaxDepth = 32;
+
+  enum class Op : uint8_t {
+    CONST,
+    REG_A,
+    REG_X,
+    REG_Y,
+    REG_SP,
+    REG_P,
+    REG_PC,
+    SCANLINE,
+    DOT,
+    BANK,
+    MEM,
+    DEREF,
+    NEG,
+    NOT,
+    INV,
+    MUL,
+    DIV,
+    MOD,
+    ADD,
+    SUB,
+    SHL,
+    SHR,
+    LT,
+    LE,
+    GT,
+    GE,
+    EQ,
+    NE,
+    AND,
+    XOR,
+    OR,
+    LAND,
+    LOR,
+  };
+
+  struct Instr {
+    Op op;
+    int32_t arg;
+  };
+
+  struct Parser;
+
+  std::string src_;
+  std::vector<Instr> code_;
+};
+
+} // namespace sys
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <bitset>
 #include <chrono>
+#include <stdexcept>
 
 using vid::PPU;
 
@@ -25,7 +26,17 @@ namespace sys {
 
 NESDebugger::NESDebugger(NES &console)
     : dbg::Debugger(false, false), console_(console),
-      init_time_(std::chrono::system_clock::now()) {}
+      init_time_(std::chrono::system_clock::now()) {
+  maps_.prg.resize(console_.cart().prgRomSize);
+  console_.mapper_->setWatchHandler(
+      [this](AddressT addr, uint8_t access) { onWatch(addr, access); });
+}
+
+NESDebugger::~NESDebugger() {
+  for (auto e = edits_.pop(); e; e = edits_.pop()) {
+    delete e->add;
+  }
+}
 
 void NESDebugger::setLogging(bool l) {
   if (l && !logging_) {
@@ -36,6 +47,11 @@ void NESDebugger::setLogging(bool l) {
     assert(log_stream_);
   }
   logging_ = l;
+  if (isLogging()) {
+    attach(Hook::LOG);
+  } else {
+    detach(Hook::LOG);
+  }
 }
 
 void NESDebugger::setRecording(bool r) {
@@ -45,6 +61,7 @@ void NESDebugger::setRecording(bool r) {
     std::cerr << "RECORD: " << recordfile << std::endl;
     recording_stream_.open(recordfile, std::ios::out | std::ios::binary);
     assert(recording_stream_);
+    recording_stream_.write(MovieMagic.data(), MovieMagic.size());
   }
   recording_ = r;
 }
@@ -64,12 +81,35 @@ const instr::Instruction &NESDebugger::step(const instr::Instruction &in,
                                             const cpu::CpuState &cpu_state,
                                             mem::Mapper &mapper) {
   curr_pc_ = in.pc;
-
-  auto match = std::any_of(
-      std::begin(breakpoints_), std::end(breakpoints_),
-      [&](const std::unique_ptr<Breakpoint> &bp) { return bp->check(in); });
+  applyEdits();
+
+  bool match = false;
+  if (isHooked(Hook::BREAK)) {
+    match = maps_.pc.test(in.pc) || watch_hit_ || checkPrg(in.pc);
+    if (!scan_.empty() || maps_.guarded.test(in.pc)) {
+      ExprContext ctx{
+          cpu_state,
+          *console_.mapper_,
+          console_.currScanline(),
+          console_.currPpuCycle(),
+          isLogging() ? static_cast<std::ostream &>(log_stream_) : std::cerr,
+      };
+      // NOTE(oren): no short circuit here, tracepoints print as a side effect
+      auto [first, last] = maps_.at_pc.equal_range(in.pc);
+      for (auto it = first; it != last; ++it) {
+        match |= it->second->evaluate(in, ctx);
+      }
+      for (const auto *bp : scan_) {
+        match |= bp->evaluate(in, ctx);
+      }
+    }
+  }
 
   if (match && !resume_) {
+    if (watch_hit_) {
+      std::cout << "WATCH! 0x" << std::hex << std::setw(4) << watch_addr_
+                << std::dec << std::endl;
+    }
     std::cout << "BREAK! " << InstrToStr(in) << std::endl;
     in.discard = true;
     setMode(Mode::BREAK);
@@ -77,26 +117,123 @@ const instr::Instruction &NESDebugger::step(const instr::Instruction &in,
     setMode(Mode::PAUSE);
   }
 
-  if (!in.discard) {
+  if (!in.discard && isHooked(Hook::HISTORY)) {
     instr_cache_.insert(in);
   }
 
-  if (isLogging()) {
+  if (isHooked(Hook::LOG)) {
     log_stream_ << std::left << std::setw(40) << InstrToStr(in) << CpuStateStr()
-                << " (C: " << in.issueCycle << ")\n";
+                << " (C: " << in.issueCycle + console_.dmaCycles() << ")\n";
   }
 
   resume_ = false;
+  watch_hit_ = false;
+  detach(Hook::STEP);
 
   return in;
 }
 
+bool NESDebugger::checkPrg(AddressT pc) {
+  if (maps_.prg.empty() || pc < 0x8000) {
+    return false;
+  }
+  auto off = console_.mapper_->prgRomOffset(pc);
+  return off >= 0 && maps_.prg.test(off);
+}
+
+void NESDebugger::onWatch(AddressT addr, uint8_t access) {
+  if (((access & mapper::NESMapper::WATCH_R) && maps_.read.test(addr)) ||
+      ((access & mapper::NESMapper::WATCH_W) && maps_.write.test(addr))) {
+    watch_hit_ = true;
+    watch_addr_ = addr;
+  }
+}
+
+void NESDebugger::pushEdit(const Edit &e) {
+  if (!edits_.push(e)) {
+    delete e.add;
+    throw std::runtime_error("Too many pending breakpoint edits");
+  }
+  // NOTE(oren): after the push, so the emulation thread can't take the hook
+  // down before it sees the edit
+  attach(Hook::EDIT);
+}
+
+void NESDebugger::drainEdits() {
+  detach(Hook::EDIT);
+  bool disabled = false;
+  for (auto e = edits_.pop(); e; e = edits_.pop()) {
+    if (e->add != nullptr) {
+      breakpoints_.emplace_back(e->add);
+      armBreakpoint(*breakpoints_.back());
+    } else if (e->disable < breakpoints_.size()) {
+      breakpoints_[e->disable]->enable(false);
+      disabled = true;
+    }
+  }
+  if (disabled) {
+    rebuildBreakpoints();
+  } else {
+    syncWatchPages();
+    syncBreakHook();
+  }
+
+  auto &list = listing_.back();
+  list.clear();
+  for (const auto &bp : breakpoints_) {
+    list.push_back({bp->str(), bp->isEnabled()});
+  }
+  listing_.publish();
+}
+
+void NESDebugger::armBreakpoint(Breakpoint &bp) {
+  if (bp.isEnabled() && !bp.arm(maps_)) {
+    scan_.push_back(&bp);
+  }
+}
+
+void NESDebugger::rebuildBreakpoints() {
+  maps_.clear();
+  scan_.clear();
+  for (auto &bp : breakpoints_) {
+    armBreakpoint(*bp);
+  }
+  syncWatchPages();
+  syncBreakHook();
+}
+
+void NESDebugger::syncWatchPages() {
+  for (uint32_t page = 0; page < 0x100; ++page) {
+    uint8_t access = 0;
+    if (maps_.read.testPage(page << 8)) {
+      access |= mapper::NESMapper::WATCH_R;
+    }
+    if (maps_.write.testPage(page << 8)) {
+      access |= mapper::NESMapper::WATCH_W;
+    }
+    console_.mapper_->markPage(page, access);
+  }
+}
+
+void NESDebugger::syncBreakHook() {
+  if (!maps_.pc.empty() || !maps_.guarded.empty() || !maps_.prg.empty() ||
+      !maps_.read.empty() || !maps_.write.empty() || !scan_.empty()) {
+    attach(Hook::BREAK);
+  } else {
+    detach(Hook::BREAK);
+  }
+}
+
 void NESDebugger::processInput(uint8_t joy_id, uint8_t btn, uint8_t state) {
   if (isRecording()) {
+    // NOTE(oren): stamped with the cycle the press lands on, so playback can
+    // apply it on the same one
+    uint64_t cycle = console_.cycle();
     // TODO(oren): process through a struct/union
     uint32_t v = (static_cast<uint32_t>(joy_id) << 16) |
                  (static_cast<uint32_t>(btn) << 8) |
                  (static_cast<uint32_t>(state));
+    recording_stream_.write(reinterpret_cast<char *>(&cycle), sizeof(cycle));
     recording_stream_.write(reinterpret_cast<char *>(&v), sizeof(v));
   }
 }
@@ -6,9 +6,13 @@
 #include "ppu_registers.hpp"
 #include "util.hpp"
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace sys {
 class NES;
@@ -20,11 +24,13 @@ constexpr int PAD_W = 374;
 constexpr int PAD_H = 240;
 
 class NESDebugger : public dbg::Debugger {
-  using RenderBuffer = std::array<std::array<uint8_t, 3>, DBG_W * DBG_H>;
   using FrameBuffer = std::array<std::array<uint8_t, 3>, DBG_W * DBG_H>;
   static constexpr int I_RINGBUF_SZ = 64;
 
 public:
+  // The PPU debug view (see renderPpuDbg)
+  using RenderBuffer = std::array<std::array<uint8_t, 3>, DBG_W * DBG_H>;
+
   enum class Mode {
     RUN,
     PAUSE,
@@ -32,21 +38,37 @@ public:
     BREAK,
   };
 
+  // Each debugger feature registers its own hook. The console only routes
+  // instructions through step() while at least one hook is attached, so an
+  // idle debugger costs nothing on the hot path.
+  enum class Hook : uint8_t {
+    BREAK = 0b0001,
+    HISTORY = 0b0010,
+    LOG = 0b0100,
+    STEP = 0b1000,
+    EDIT = 0b10000,
+  };
+
   using InstructionCache = util::RingBuf<instr::Instruction, I_RINGBUF_SZ>;
 
+  // What the UI shows for each breakpoint, in the order they were set
+  struct BreakpointInfo {
+    std::string desc;
+    bool enabled;
+  };
+  using BreakpointList = std::vector<BreakpointInfo>;
+
   explicit NESDebugger(NES &console);
-  ~NESDebugger() = default;
+  ~NESDebugger();
   instr::Instruction const &step(const instr::Instruction &in,
                                  const cpu::CpuState &state,
                                  mem::Mapper &mapper) override;
   void renderPpuDbg(RenderBuffer &buf);
+  // Recordings start with this, then hold a 64 bit CPU cycle and a 32 bit
+  // event for each press and release (see sdl_internal::MoviePlayer)
+  static constexpr std::array<char, 8> MovieMagic = {'O', 'H', 'N', 'E',
+                                                     'S', 'M', 'V', '2'};
   void processInput(uint8_t joy_id, uint8_t btn, uint8_t state);
-  void nextFrame() {
-    if (isRecording()) {
-      uint32_t end = UINT32_MAX;
-      recording_stream_.write(reinterpret_cast<char *>(&end), sizeof(end));
-    }
-  }
 
   void selectNametable(uint8_t s) { nt_select = s; }
   void cyclePalete() { ptable_pidx = (ptable_pidx + 1) & 0b111; }
@@ -57,6 +79,7 @@ public:
     } else {
       if (mode() == Mode::BREAK) {
         resume_ = true;
+        attach(Hook::STEP);
       }
       setMode(Mode::RUN);
     }
@@ -68,11 +91,15 @@ public:
     if (mode() == Mode::BREAK) {
       resume_ = true;
     }
+    attach(Hook::STEP);
     setMode(Mode::STEP);
   }
 
   Mode mode() const { return dbg_mode; }
 
+  bool hooked() const { return hooks_ != 0; }
+  bool isHooked(Hook h) const { return hooks_ & static_cast<uint8_t>(h); }
+
   const InstructionCache &cache() const { return instr_cache_; }
   instr::Instruction history(int idx) const;
 
@@ -83,29 +110,63 @@ public:
   bool isLogging() { return logging_ && log_stream_; }
   void setRecording(bool l);
   bool isRecording() { return recording_ && recording_stream_; }
+  void setHistory(bool h) {
+    if (h) {
+      attach(Hook::HISTORY);
+    } else {
+      detach(Hook::HISTORY);
+    }
+  }
 
+  // NOTE(oren): breakpoints can be set from any one thread (the debugger UI
+  // runs on its own). The edits are queued and the emulation thread applies
+  // them at the next instruction boundary, or at once while paused.
   template <typename T, typename... Args> void setBreakpoint(Args... args) {
-    if (breakpoints_.size() >= 32) {
-      std::cerr << "Exceeded 32 Breakpoint max..." << std::endl;
-      return;
-    }
-    breakpoints_.push_back(std::make_unique<T>(args...));
+    pushEdit({new T(args...), 0});
   }
 
-  void disableBreakpoint(size_t i) {
-    if (0 <= i && i < breakpoints_.size()) {
-      breakpoints_[i]->enable(false);
+  void disableBreakpoint(size_t i) { pushEdit({nullptr, i}); }
+
+  // Emulation thread. Apply queued breakpoint edits, if there are any.
+  void applyEdits() {
+    if (isHooked(Hook::EDIT)) {
+      drainEdits();
     }
   }
 
+  // Emulation thread only
   const std::vector<std::unique_ptr<Breakpoint>> &breakpoints() const {
     return breakpoints_;
   }
 
+  // Debugger UI thread. A copy of the breakpoint list as of the last applied
+  // edit, valid until the next call.
+  const BreakpointList &listing() {
+    listing_.acquire();
+    return listing_.front();
+  }
+
+  // cid: 0-3 for pulse 1, pulse 2, triangle and noise, 4 for the DMC
   void muteApuChannel(int cid, bool e);
 
 private:
   void setMode(Mode s) { dbg_mode = s; }
+  void attach(Hook h) { hooks_ |= static_cast<uint8_t>(h); }
+  void detach(Hook h) { hooks_ &= ~static_cast<uint8_t>(h); }
+  struct Edit {
+    // set this breakpoint (owned by the queue until applied), else disable
+    // the one at index disable
+    Breakpoint *add = nullptr;
+    size_t disable = 0;
+  };
+  void pushEdit(const Edit &e);
+  void drainEdits();
+  void syncBreakHook();
+  void armBreakpoint(Breakpoint &bp);
+  void rebuildBreakpoints();
+  void syncWatchPages();
+  void onWatch(AddressT addr, uint8_t access);
+  bool checkPrg(AddressT pc);
   void set_pixel(int x, int y, std::array<uint8_t, 3> const &rgb,
                  FrameBuffer &buf);
   uint16_t calc_nt_base(int x, int y);
@@ -136,6 +197,7 @@ private:
   uint8_t nt_select = 0;
   uint8_t ptable_pidx = 0;
   std::atomic<Mode> dbg_mode{Mode::RUN};
+  std::atomic<uint8_t> hooks_{0};
   bool logging_ = false;
   std::ofstream log_stream_;
   bool recording_ = false;
@@ -143,6 +205,13 @@ private:
   std::chrono::system_clock::time_point init_time_;
 
   std::vector<std::unique_ptr<Breakpoint>> breakpoints_;
+  util::SpscQueue<Edit, 64> edits_;
+  util::TripleBuffer<BreakpointList> listing_;
+  // breakpoints that can't be indexed by address, checked every instruction
+  std::vector<Breakpoint *> scan_;
+  BreakMaps maps_;
+  bool watch_hit_ = false;
+  AddressT watch_addr_ = 0;
   bool resume_ = false;
 
   friend std::ostream &operator<<(std::ostream &os, NESDebugger &dbg);
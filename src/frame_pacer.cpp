@@ -0,0 +1,89 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace sys {
+
+FrameTimes::Summary FrameTimes::summary() const {
+  Summary s;
+  s.count = ns_.size();
+  if (ns_.empty()) {
+    return s;
+  }
+  auto ms = [](double ns) { return ns / 1e6; };
+  auto sorted = ns_;
+  std::sort(sorted.begin(), sorted.end());
+  auto pct = [&](double p) {
+    auto i = static_cast<size_t>(std::ceil(p * sorted.size())) - 1;
+    return ms(sorted[std::min(i, sorted.size() - 1)]);
+  };
+  s.p50 = pct(0.50);
+  s.p99 = pct(0.99);
+  s.max = ms(sorted.back());
+
+  double sum = 0.0;
+  for (auto t : ns_) {
+    sum += t;
+  }
+  double mean = sum / ns_.size();
+  double var = 0.0;
+  for (auto t : ns_) {
+    var += (t - mean) * (t - mean);
+  }
+  s.mean = ms(mean);
+  s.jitter = ms(std::sqrt(var / ns_.size()));
+  return s;
+}
+
+std::vector<size_t> FrameTimes::histogram(
+    std::span<const double> bounds) const {
+  std::vector<size_t> counts(bounds.size() + 1);
+  for (auto t : ns_) {
+    auto it = std::upper_bound(bounds.begin(), bounds.end(), t / 1e6);
+    ++counts[it - bounds.begin()];
+  }
+  return counts;
+}
+
+FramePacer::FramePacer(Period period)
+    : period_(period), epoch_(Clock::now()), last_(epoch_) {}
+
+bool FramePacer::wait() {
+  auto deadline =
+      epoch_ + std::chrono::duration_cast<Clock::duration>(
+                   period_ * static_cast<double>(frame_ + 1));
+  auto now = Clock::now();
+  bool on_time = now < deadline;
+
+  if (on_time) {
+    if (deadline - now > SpinMargin) {
+      std::this_thread::sleep_until(deadline - SpinMargin);
+    }
+    while (Clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    ++frame_;
+  } else if (now - deadline > MaxBehind * period_) {
+    // NOTE(oren): a long stall, or a machine that can't keep up. Start over
+    // from here rather than racing through a burst of frames to catch up.
+    epoch_ = now;
+    frame_ = 0;
+  } else {
+    ++frame_;
+  }
+
+  now = Clock::now();
+  times_.add(now - last_);
+  last_ = now;
+  return on_time;
+}
+
+void FramePacer::resync() {
+  epoch_ = Clock::now();
+  last_ = epoch_;
+  frame_ = 0;
+}
+
+} // namespace sys
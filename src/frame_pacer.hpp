@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace sys {
+
+// Frame intervals, for reporting how evenly frames were delivered.
+class FrameTimes {
+public:
+  // all in milliseconds
+  struct Summary {
+    size_t count = 0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+    // standard deviation
+    double jitter = 0.0;
+  };
+
+  void add(std::chrono::nanoseconds t) { ns_.push_back(t.count()); }
+  size_t size() const { return ns_.size(); }
+  Summary summary() const;
+  // Counts of times under each of the ascending bounds (in milliseconds)
+  // and at or above the one before it, plus a last count for those at or
+  // above the final bound
+  std::vector<size_t> histogram(std::span<const double> bounds) const;
+
+private:
+  std::vector<int64_t> ns_;
+};
+
+// Holds a loop to the NTSC frame rate no matter what the display refreshes
+// at (or whether it syncs at all).
+//
+// Deadlines are computed from a frame count rather than accumulated, so
+// rounding never builds up. Waits sleep until shortly before the deadline
+// and spin the rest of the way, since a sleep can overshoot by a millisecond
+// or more.
+class FramePacer {
+public:
+  using Clock = std::chrono::steady_clock;
+  using Period = std::chrono::duration<double>;
+
+  // 357366 cycles of the 236.25MHz / 11 master clock (29780.5 CPU cycles),
+  // ~60.0988Hz
+  static constexpr Period FramePeriod{357366.0 * 11 / 236.25e6};
+  static constexpr std::chrono::microseconds SpinMargin{2000};
+  // frames we may fall behind by before giving up on catching up
+  static constexpr int MaxBehind = 4;
+
+  explicit FramePacer(Period period = FramePeriod);
+
+  // Wait for the next deadline. Returns false if it had already passed.
+  bool wait();
+  // Count deadlines from now, e.g. after a pause. The gap isn't recorded.
+  void resync();
+
+  Period period() const { return period_; }
+  const FrameTimes &times() const { return times_; }
+
+private:
+  Period period_;
+  Clock::time_point epoch_;
+  uint64_t frame_ = 0;
+  Clock::time_point last_;
+  FrameTimes times_;
+};
+
+} // namespace sys
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace vid {
+constexpr size_t WIDTH = 256;
+constexpr size_t HEIGHT = 240;
+
+// The PPU's raw output: a 6 bit palette index in bits 0-5 and the PPUMASK
+// color emphasis bits (red, green, blue) in bits 6-8. Consumers turn these
+// into RGB with PPU::FullPalette, or into a composite signal.
+using Pixel = uint16_t;
+using Rgb = std::array<uint8_t, 3>;
+using FrameBuffer = std::array<Pixel, WIDTH * HEIGHT>;
+using FrameView = std::span<const Pixel, WIDTH * HEIGHT>;
+// A fingerprint of each scanline, so consumers can tell which rows (or
+// whether any) changed between frames without comparing pixels
+using RowHashes = std::array<uint64_t, HEIGHT>;
+using RowView = std::span<const uint64_t, HEIGHT>;
+
+// Completed frames on their way from the PPU to whoever shows, records or
+// hashes them.
+//
+// Triple buffered: the PPU draws into the back buffer while the consumer
+// reads the front one, and a third "ready" buffer sits between them. Handing
+// a frame across is an exchange of buffer indices, so pixels are never
+// copied and neither side waits on the other. If the consumer falls behind,
+// the PPU simply overwrites the unread ready frame.
+//
+// Buffers are reused without clearing; the PPU writes every visible dot of
+// every frame, and fingerprints each row as it finishes it.
+class FrameQueue {
+public:
+  FrameQueue() = default;
+  FrameQueue(const FrameQueue &) = delete;
+  FrameQueue &operator=(const FrameQueue &) = delete;
+
+  // Producer side. The buffer being drawn into.
+  FrameBuffer &back() { return bufs_[back_].pixels; }
+
+  // Producer side. Row y of the back buffer is finished.
+  void finishRow(size_t y) {
+    auto &f = bufs_[back_];
+    f.rows[y] = HashRow(f.pixels.data() + y * WIDTH);
+  }
+
+  // Producer side. Hand the back buffer over as the latest frame and take
+  // the old ready buffer to draw the next one into.
+  void publish(uint8_t phase = 0) {
+    auto &f = bufs_[back_];
+    f.phase = phase;
+    f.number = published_ + 1;
+    f.hash = 0;
+    for (size_t y = 0; y < HEIGHT; ++y) {
+      f.hash = (f.hash ^ f.rows[y]) * Prime;
+    }
+    auto prev = ready_.exchange(back_ | Fresh, std::memory_order_acq_rel);
+    latest_ = back_;
+    back_ = prev & IndexMask;
+    ++published_;
+  }
+
+  // Consumer side. Move the latest frame to the front, if there's one we
+  // haven't seen. Returns whether the front changed.
+  bool acquire() {
+    if ((ready_.load(std::memory_order_relaxed) & Fresh) == 0) {
+      return false;
+    }
+    auto prev = ready_.exchange(front_, std::memory_order_acq_rel);
+    front_ = prev & IndexMask;
+    return true;
+  }
+
+  // Consumer side. Valid until the next acquire().
+  FrameView front() const { return FrameView(bufs_[front_].pixels); }
+  RowView frontRows() const { return RowView(bufs_[front_].rows); }
+  uint64_t frontHash() const { return bufs_[front_].hash; }
+  // Phase of the color subcarrier (0-11) at the start of the frame. It
+  // shifts from frame to frame, which makes composite artifacts crawl.
+  uint8_t frontPhase() const { return bufs_[front_].phase; }
+  // Which frame this is, counting from 1 (see published())
+  uint64_t frontNumber() const { return bufs_[front_].number; }
+
+  // Producer side. The frame just published, for recording it on the
+  // producer's thread. The consumer may be reading it too, but it isn't drawn
+  // into again until after the next publish(), so it's valid until then.
+  FrameView latest() const { return FrameView(bufs_[latest_].pixels); }
+
+  // Frames published so far (producer side only)
+  uint64_t published() const { return published_; }
+
+  // NOTE(oren): runs once per scanline, so it needs to be a tiny fraction of
+  // the ~341 dots' worth of PPU work it follows. Four independent
+  // multiply-xor lanes over 64 bit words keep the multiplies pipelined.
+  // Each step is invertible, so a change to any single word always changes
+  // the hash.
+  static uint64_t HashRow(const Pixel *row) {
+    constexpr size_t Words = WIDTH * sizeof(Pixel) / sizeof(uint64_t);
+    static_assert(Words % 4 == 0);
+    auto bytes = reinterpret_cast<const uint8_t *>(row);
+    std::array<uint64_t, 4> h = {1, 2, 3, 4};
+    for (size_t i = 0; i < Words; i += 4) {
+      for (size_t l = 0; l < h.size(); ++l) {
+        uint64_t w;
+        std::memcpy(&w, bytes + (i + l) * sizeof(w), sizeof(w));
+        h[l] = (h[l] ^ w) * Prime;
+      }
+    }
+    auto rotl = [](uint64_t v, int n) { return (v << n) | (v >> (64 - n)); };
+    return h[0] ^ rotl(h[1], 16) ^ rotl(h[2], 32) ^ rotl(h[3], 48);
+  }
+
+private:
+  static constexpr uint8_t IndexMask = 0b011;
+  static constexpr uint8_t Fresh = 0b100;
+  static constexpr uint64_t Prime = 0x100000001B3ull;
+
+  struct Frame {
+    FrameBuffer pixels;
+    RowHashes rows;
+    uint64_t hash;
+    uint8_t phase;
+    uint64_t number;
+  };
+
+  std::array<Frame, 3> bufs_ = {};
+  uint8_t back_ = 0;
+  std::atomic<uint8_t> ready_ = 1;
+  uint8_t front_ = 2;
+  uint8_t latest_ = 0;
+  uint64_t published_ = 0;
+};
+
+} // namespace vid
@@ -1,4 +1,5 @@
 #include "joypad.hpp"
+#include "latency_probe.hpp"
 
 namespace ctrl {
 uint8_t JoyPad::NextId = 0;
@@ -6,14 +7,24 @@ uint8_t JoyPad::NextId = 0;
 uint8_t JoyPad::readNext() {
   if (curr_ >= state_.size()) {
     return 0x01;
-  } else if (strobe_) {
+  }
+  if (curr_ == probed_ && state_[curr_] != 0) {
+    probe_->read();
+    probed_ = NoProbe;
+  }
+  if (strobe_) {
     return state_[curr_];
   } else {
     return state_[curr_++];
   }
 }
 
-void JoyPad::press(Button const b) { state_[static_cast<uint8_t>(b)] = 0x01; }
+void JoyPad::press(Button const b) {
+  state_[static_cast<uint8_t>(b)] = 0x01;
+  if (probe_ != nullptr && probe_->applied()) {
+    probed_ = static_cast<uint8_t>(b);
+  }
+}
 
 void JoyPad::release(Button const b) { state_[static_cast<uint8_t>(b)] = 0x00; }
 
@@ -5,6 +5,10 @@
 
 #include <iostream>
 
+namespace sys {
+class LatencyProbe;
+}
+
 namespace ctrl {
 enum class Button : uint8_t {
   A = 0,
@@ -33,6 +37,8 @@ struct JoyPad {
   }
   void unclaim() { claimed_ = false; }
   uint8_t peek(ctrl::Button b) const { return state_[static_cast<uint8_t>(b)]; }
+  // Report presses, and the game's first read of them, to probe
+  void setProbe(sys::LatencyProbe *probe) { probe_ = probe; }
 
   const uint8_t ID = NextId++;
 
@@ -42,5 +48,9 @@ private:
   uint8_t curr_ = 0;
   bool strobe_ = false;
   bool claimed_ = false;
+  sys::LatencyProbe *probe_ = nullptr;
+  // the button whose press the probe is following, if it's on this pad
+  uint8_t probed_ = NoProbe;
+  static constexpr uint8_t NoProbe = 0xFF;
 };
 } // namespace ctrl
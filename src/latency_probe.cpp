@@ -0,0 +1,104 @@
+#include "latency_probe.hpp"
+
+#include <iomanip>
+
+namespace sys {
+
+void LatencyProbe::polled() {
+  auto now = Clock::now();
+  int stage = next_.load(std::memory_order_acquire);
+  if (stage != Polled) {
+    if (now - at(Polled) < Timeout ||
+        !next_.compare_exchange_strong(stage, Polled,
+                                       std::memory_order_acq_rel)) {
+      return;
+    }
+    ++abandoned_;
+  }
+  at_[Polled].store(now.time_since_epoch().count(),
+                    std::memory_order_relaxed);
+  next_.store(Applied, std::memory_order_release);
+}
+
+bool LatencyProbe::applied() {
+  auto now = Clock::now();
+  if (!advance(Applied, now)) {
+    return false;
+  }
+  times_[Applied].add(now - at(Polled));
+  return true;
+}
+
+bool LatencyProbe::read() {
+  auto now = Clock::now();
+  if (!advance(Read, now)) {
+    return false;
+  }
+  times_[Read].add(now - at(Applied));
+  return true;
+}
+
+bool LatencyProbe::completed(uint64_t frame) {
+  auto now = Clock::now();
+  if (next_.load(std::memory_order_acquire) != Completed) {
+    return false;
+  }
+  frame_.store(frame, std::memory_order_relaxed);
+  if (!advance(Completed, now)) {
+    return false;
+  }
+  times_[Completed].add(now - at(Read));
+  return true;
+}
+
+void LatencyProbe::presented(uint64_t frame) {
+  auto now = Clock::now();
+  if (next_.load(std::memory_order_acquire) != Presented ||
+      frame < frame_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  times_[Presented].add(now - at(Completed));
+  times_[Polled].add(now - at(Polled));
+  next_.store(Polled, std::memory_order_release);
+}
+
+bool LatencyProbe::advance(Stage stage, Clock::time_point now) {
+  int expected = stage;
+  if (next_.load(std::memory_order_acquire) != expected) {
+    return false;
+  }
+  at_[stage].store(now.time_since_epoch().count(), std::memory_order_relaxed);
+  // NOTE(oren): the UI thread may have abandoned the press since the check
+  // above, in which case this stage isn't counted
+  return next_.compare_exchange_strong(expected, stage + 1,
+                                       std::memory_order_acq_rel);
+}
+
+void LatencyProbe::report(std::ostream &out) const {
+  static constexpr std::array<double, 7> Bounds = {1, 2, 4, 8, 16, 32, 64};
+  static constexpr std::array<const char *, Stages> Names = {
+      "total", "polled->applied", "applied->read", "read->completed",
+      "completed->presented"};
+
+  out << "Input latency (" << total().size() << " presses, " << abandoned_
+      << " abandoned), ms:" << std::endl;
+  out << std::setw(22) << "";
+  for (double b : Bounds) {
+    out << std::setw(6) << "<" + std::to_string(static_cast<int>(b));
+  }
+  out << std::setw(6) << "more" << "    p50    p99    max" << std::endl;
+
+  for (int s : {Applied, Read, Completed, Presented, Polled}) {
+    auto &t = times_[s];
+    out << std::setw(22) << Names[s];
+    for (auto n : t.histogram(Bounds)) {
+      out << std::setw(6) << n;
+    }
+    auto sum = t.summary();
+    out << std::fixed << std::setprecision(2) << std::setw(7) << sum.p50
+        << std::setw(7) << sum.p99 << std::setw(7) << sum.max
+        << std::defaultfloat << std::endl;
+  }
+}
+
+} // namespace sys
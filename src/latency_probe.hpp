@@ -0,0 +1,72 @@
+#pragma once
+
+#include "frame_pacer.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace sys {
+
+// Follows button presses from the host to the screen, timing each stage:
+//
+//   polled     the UI thread takes the event from SDL
+//   applied    the emulation thread presses the button on the pad
+//   read       the game first reads the button as pressed
+//   completed  the frame the game read it in is finished
+//   presented  the present that first shows that frame returns
+//
+// One press is followed at a time; presses while it's in flight aren't
+// timed. Polling and presenting happen on the UI thread and the rest on the
+// emulation thread, so the stage in flight is handed across atomically and
+// only the thread whose stage it is records it.
+//
+// A press can stall along the way, if its key isn't mapped to the pad or the
+// game isn't reading input. It's abandoned if a new press arrives once it's
+// been in flight for Timeout.
+class LatencyProbe {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum Stage { Polled, Applied, Read, Completed, Presented, Stages };
+
+  static constexpr std::chrono::seconds Timeout{1};
+
+  // UI thread
+  void polled();
+  void presented(uint64_t frame);
+
+  // Emulation thread. Return whether the stage was recorded, i.e. whether
+  // it belonged to the press in flight.
+  bool applied();
+  bool read();
+  // frame is the number of the completed frame (FrameQueue::published)
+  bool completed(uint64_t frame);
+
+  // Time from the stage before to each stage, and from polled to presented.
+  // Only stable once both threads have stopped.
+  const FrameTimes &times(Stage stage) const { return times_[stage]; }
+  const FrameTimes &total() const { return times_[Polled]; }
+  uint64_t abandoned() const { return abandoned_; }
+
+  // Summaries and histograms of each stage
+  void report(std::ostream &out) const;
+
+private:
+  bool advance(Stage stage, Clock::time_point now);
+  Clock::time_point at(Stage stage) const {
+    return Clock::time_point(
+        Clock::duration(at_[stage].load(std::memory_order_relaxed)));
+  }
+
+  std::atomic<int> next_ = Polled;
+  std::array<std::atomic<Clock::rep>, Stages> at_ = {};
+  std::atomic<uint64_t> frame_ = 0;
+  // times_[Polled] holds the totals
+  std::array<FrameTimes, Stages> times_;
+  uint64_t abandoned_ = 0;
+};
+
+} // namespace sys
@@ -1,16 +1,22 @@
+#include "capture.hpp"
 #include "dbg/nes_debugger.hpp"
+#include "latency_probe.hpp"
+#include "ntsc_filter.hpp"
 #include "ppu.hpp"
 #include "sdl/audio.hpp"
 #include "sdl/display.hpp"
+#include "sdl/emu_thread.hpp"
 #include "sdl/input.hpp"
 #include "sdl/movie_player.hpp"
 #include "system.hpp"
+#include "upscaler.hpp"
 #include "wx_/dbg_app.h"
 
 #include <SDL.h>
 #include <args.hxx>
 
 #include "time.h"
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -22,6 +28,7 @@ using dbg::DebuggerApp;
 using sdl_internal::Audio;
 using sdl_internal::ControllerInputHandler;
 using sdl_internal::Display;
+using sdl_internal::EmuThread;
 using sdl_internal::KeyboardInputHandler;
 using sdl_internal::RecordingInputHandler;
 using sys::NES;
@@ -41,6 +48,40 @@ int main(int argc, char **argv) {
 
   args::ValueFlag<std::string> movie(argparse, "", "Control recording playback",
                                      {"movie"});
+  args::ValueFlag<std::string> wav(argparse, "file",
+                                   "Write audio to a WAV file instead of "
+                                   "playing it",
+                                   {"wav"});
+  args::ValueFlag<std::string> capture(
+      argparse, "base",
+      "Record video and audio to base.y4m and base.wav instead of playing "
+      "audio",
+      {"capture"});
+  args::Flag capture_raw(argparse, "",
+                         "Capture raw pixels (base.nesv) and the palette "
+                         "(base.pal) rather than Y4M",
+                         {"capture-raw"});
+  args::ValueFlag<std::string> stems(
+      argparse, "file",
+      "Also write each APU channel to a 5 channel WAV file", {"stems"});
+  args::ValueFlag<double> latency(argparse, "ms",
+                                  "Target audio buffer latency (default 50)",
+                                  {"latency"}, aud::APU::DefaultLatency);
+  args::Flag latency_probe(argparse, "",
+                           "Time button presses from input to screen, and "
+                           "report on exit",
+                           {"latency-probe"});
+  args::Flag adaptive_sync(argparse, "",
+                           "Present frames as soon as they're ready, for "
+                           "adaptive sync displays (no vsync)",
+                           {"adaptive-sync"});
+  args::ValueFlag<int> ntsc(argparse, "scale",
+                            "Decode video through an NTSC composite filter, "
+                            "2 or 3 times as wide",
+                            {"ntsc"});
+  args::ValueFlag<std::string> upscale(
+      argparse, "filter", "Upscale video with scale2x, scale3x or xbr2x",
+      {"upscale"});
 
   args::Group debugging(argparse, "Debugging:");
   args::Flag debug(debugging, "", "CPU debugger", {"debug"});
@@ -48,6 +89,20 @@ int main(int argc, char **argv) {
   args::Flag brk(debugging, "", "Immediately break", {'b', "break"});
   args::Flag log(debugging, "", "Enable instruction logging", {"log"});
   args::Flag record(debugging, "", "Enable controller recording", {"record"});
+  args::ValueFlagList<std::string> cond_bp(
+      debugging, "[PC:]expr", "Conditional breakpoint, e.g. 'C000:A == $3F'",
+      {"bp"});
+  args::ValueFlagList<std::string> trace(
+      debugging, "[PC:]format", "Tracepoint, e.g. 'C000:A={A} sl={scanline:d}'",
+      {"trace"});
+  args::ValueFlagList<std::string> watch(
+      debugging, "[rwx]:addr[-addr]", "Watchpoint, e.g. 'w:0300-03FF'",
+      {"watch"});
+  args::ValueFlagList<std::string> prg_bp(
+      debugging, "offset",
+      "Breakpoint on a PRG ROM offset, so only while that bank is mapped, "
+      "e.g. '1C010'",
+      {"bp-prg"});
 
   try {
     argparse.ParseCLI(argc, argv);
@@ -64,18 +119,47 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  NES nes(romfile.Get(), debug.Get() || log.Get());
+  bool points = cond_bp || trace || watch || prg_bp;
+  NES nes(romfile.Get(), debug.Get() || log.Get() || points);
   std::unique_ptr<DebuggerApp> cpu_debugger;
   if (debug.Get()) {
     cpu_debugger = std::make_unique<DebuggerApp>(nes);
+    nes.debugger().setHistory(true);
     if (brk.Get()) {
       nes.debugger().pause(true);
     }
   }
 
   nes.debugger().setLogging(log.Get());
+
+  try {
+    for (auto spec : cond_bp.Get()) {
+      auto pc = sys::Expression::SplitPc(spec);
+      nes.debugger().setBreakpoint<sys::CondBreakpoint>(true, pc, spec);
+    }
+    for (auto spec : trace.Get()) {
+      auto pc = sys::Expression::SplitPc(spec);
+      nes.debugger().setBreakpoint<sys::Tracepoint>(true, pc, spec);
+    }
+    for (const auto &spec : watch.Get()) {
+      nes.debugger().setBreakpoint<sys::Watchpoint>(true, spec);
+    }
+    for (const auto &spec : prg_bp.Get()) {
+      nes.debugger().setBreakpoint<sys::PrgBreakpoint>(true, spec);
+    }
+  } catch (std::invalid_argument &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
   nes.debugger().setRecording(record.Get());
 
+  try {
+    nes.setAudioLatency(latency.Get());
+  } catch (std::invalid_argument &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
   LoadSystemPalette(DEFAULT_PALETTE);
 
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER |
@@ -100,27 +184,99 @@ int main(int argc, char **argv) {
           "DBG", "Debug: " + romfile.Get());
     }
 
+    std::unique_ptr<vid::VideoFilter> filter;
+    if (ntsc && upscale) {
+      std::cerr << "Pick one of --ntsc and --upscale" << std::endl;
+      return 1;
+    }
+    try {
+      if (ntsc) {
+        filter = std::make_unique<vid::NtscFilter>(ntsc.Get());
+      } else if (upscale) {
+        filter = std::make_unique<vid::Upscaler>(
+            vid::Upscaler::parse(upscale.Get()));
+      }
+    } catch (std::invalid_argument &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+
     auto display = std::make_unique<Display<vid::WIDTH, vid::HEIGHT, SCALE>>(
-        "NES", romfile.Get());
+        "NES", romfile.Get(), !adaptive_sync.Get());
+    display->setPalette(vid::PPU::FullPalette);
+    display->setFilter(filter.get());
 
-    auto audio = std::make_unique<Audio>();
-    audio->init();
+    std::unique_ptr<aud::Sink> audio;
+    sys::Capture *capture_sink = nullptr;
+    if (wav && capture) {
+      std::cerr << "Pick one of --wav and --capture" << std::endl;
+      return 1;
+    }
+    if (wav) {
+      try {
+        audio = std::make_unique<aud::WavSink>(wav.Get());
+      } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+    } else if (capture) {
+      try {
+        auto c = std::make_unique<sys::Capture>(
+            nes.frames(), vid::PPU::FullPalette, capture.Get(),
+            capture_raw ? sys::Capture::Format::Raw
+                        : sys::Capture::Format::Y4m);
+        capture_sink = c.get();
+        audio = std::move(c);
+      } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+    } else {
+      audio = std::make_unique<Audio>();
+    }
+    nes.setAudioSink(*audio);
+
+    std::unique_ptr<aud::WavSink> stem_sink;
+    if (stems) {
+      try {
+        stem_sink = std::make_unique<aud::WavSink>(stems.Get(), 5);
+      } catch (std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+      nes.setStemSink(*stem_sink);
+    }
+
+    EmuThread emu(nes, *audio, stem_sink.get(), movie_player);
+    std::unique_ptr<sys::LatencyProbe> probe;
+    if (latency_probe) {
+      probe = std::make_unique<sys::LatencyProbe>();
+      emu.setLatencyProbe(probe.get());
+    }
+    if (ppu_debugger != nullptr) {
+      emu.enablePpuDebugView();
+    }
 
     SDL_Event event;
     bool quit = false;
-    auto clockStart = std::chrono::steady_clock::now();
-    std::chrono::steady_clock::time_point clockEnd;
+    uint64_t shown = 0;
+    uint64_t repeated = 0;
+    sys::FrameTimes present_times;
+    auto last_present = std::chrono::steady_clock::now();
+    emu.start();
     while (!quit) {
-      movie_player.generateEvents();
       while (SDL_PollEvent(&event) != 0) {
+        if (probe != nullptr && display->hasMouseFocus() &&
+            (KeyboardInputHandler::Presses(event) ||
+             ControllerInputHandler::Presses(event))) {
+          probe->polled();
+        }
         // handle window events
         display->handleEvent(event);
         if (ppu_debugger != nullptr) {
           ppu_debugger->handleEvent(event);
         }
 
-        RecordingInputHandler::HandleEvent(event, nes,
-                                           display->hasMouseFocus());
         switch (event.type) {
         case SDL_QUIT:
           quit = true;
@@ -138,79 +294,124 @@ int main(int argc, char **argv) {
               ppu_debugger->focus();
             }
             break;
-          case SDLK_p:
-            nes.debugger().cyclePalete();
-            break;
-          case SDLK_r:
-            nes.reset(true);
-            break;
-          case SDLK_1:
-          case SDLK_2:
-          case SDLK_3:
-          case SDLK_4:
-            nes.debugger().selectNametable(event.key.keysym.sym - SDLK_1);
-            break;
           default:
             break;
           }
+          // hotkeys are still forwarded to the emulation thread
+          [[fallthrough]];
         case SDL_KEYUP:
-          KeyboardInputHandler::HandleEvent(event, nes,
-                                            display->hasMouseFocus());
+          // the console belongs to the emulation thread
+          emu.forward(event, display->hasMouseFocus());
           break;
         case SDL_CONTROLLERDEVICEADDED:
         case SDL_CONTROLLERDEVICEREMOVED:
         case SDL_CONTROLLERBUTTONDOWN:
         case SDL_CONTROLLERBUTTONUP:
-          ControllerInputHandler::HandleEvent(event, nes,
-                                              display->hasMouseFocus());
+          // controllers stay on this thread, only their buttons go across
+          if (ControllerInputHandler::HandleEvent(event, nes)) {
+            emu.forward(event, display->hasMouseFocus());
+          }
+          break;
         default:
           break;
         }
       }
 
-      // Render a whole frame before checking keyboard events. This
-      // effectively locks the polling loop to vsync. It's responsive enough.
-      do {
-        try {
-          nes.step();
-          if (nes.paused()) {
-            break;
-          }
-        } catch (std::exception &e) {
-          clockEnd = std::chrono::steady_clock::now();
-          std::cerr << e.what() << std::endl;
-          std::cerr << "Cycle: " << nes.state().cycle << std::endl;
-          std::cerr << std::hex << "PC: 0x" << +nes.state().pc << std::dec
-                    << std::endl;
-          quit = true;
-          SDL_Delay(SCREEN_DELAY);
-          break;
-        }
-      } while (!nes.render(display->renderBuf));
+      if (!emu.running()) {
+        // the console threw
+        SDL_Delay(SCREEN_DELAY);
+        quit = true;
+      }
 
-      display->update();
+      // Present the newest completed frame. The emulator keeps its own time,
+      // so this loop only decides when frames reach the screen. With vsync,
+      // presenting waits for the display and paces the loop; if the console
+      // hasn't finished another frame since, the last one goes up again.
+      // With adaptive sync, each frame goes up as soon as it's ready and the
+      // display follows.
+      bool fresh = nes.frames().acquire();
+      if (fresh) {
+        ++shown;
+        auto now = std::chrono::steady_clock::now();
+        present_times.add(now - last_present);
+        last_present = now;
+        display->update(nes.frames());
+      } else if (adaptive_sync.Get()) {
+        SDL_Delay(1);
+      } else {
+        ++repeated;
+        display->update(nes.frames());
+      }
+      if (probe != nullptr && (fresh || !adaptive_sync.Get())) {
+        probe->presented(nes.frames().frontNumber());
+      }
 
-      if (ppu_debugger != nullptr && ppu_debugger->isShown()) {
-        nes.debugger().renderPpuDbg(ppu_debugger->renderBuf);
-        ppu_debugger->update();
+      // the emulation thread renders the debug view at frame boundaries
+      if (ppu_debugger != nullptr) {
+        emu.showPpuDebugView(ppu_debugger->isShown());
+        if (emu.ppuDebugView()->acquire()) {
+          ppu_debugger->update(emu.ppuDebugView()->front());
+        }
       }
 
       if (!display->isShown()) {
         quit = true;
       }
     }
+    emu.stop();
+
+    auto report = [](const std::string &what, const sys::FrameTimes &times) {
+      auto s = times.summary();
+      std::cout << what << " frame time: " << s.p50 << "ms p50, " << s.p99
+                << "ms p99, " << s.max << "ms max, " << s.jitter
+                << "ms jitter (" << s.count << " frames)" << std::endl;
+    };
+    report("Emulated", emu.frameTimes());
+    report("Presented", present_times);
+    report(std::string("Converted (") +
+               (filter != nullptr ? filter->name() : "palette") + ")",
+           display->convertTimes());
+
+    std::cout << "Cycles: " << nes.cycle() << std::endl;
+
+    auto &emu_stats = emu.stats();
+    auto published = nes.frames().published();
+    std::cout << "Frames: " << emu_stats.frames << " emulated, " << shown
+              << " presented, " << published - std::min(published, shown)
+              << " dropped, " << repeated << " duplicated" << std::endl;
+    if (emu_stats.frames > 0) {
+      using ms = std::chrono::duration<double, std::milli>;
+      std::cout << "Emulation time: "
+                << ms(emu_stats.total_time).count() / emu_stats.frames
+                << "ms avg, " << ms(emu_stats.max_time).count()
+                << "ms max, " << emu_stats.late << " late" << std::endl;
+    }
+    if (emu_stats.inputs > 0) {
+      std::cout << "Input: " << emu_stats.inputs << " events, "
+                << emu_stats.input_late * 1000.0 / EmuThread::CyclesPerSecond /
+                       emu_stats.inputs
+                << "ms avg behind their stamps" << std::endl;
+    }
 
-    clockEnd = std::chrono::steady_clock::now();
+    auto audio_stats = nes.audio().stats();
+    auto ms = [](size_t samples) { return samples * 1000 / aud::SampleRate; };
+    std::cout << "Audio latency: " << nes.audioLatency() << "ms target, "
+              << ms(audio_stats.min_fill) << "-" << ms(audio_stats.max_fill)
+              << "ms queued" << std::endl;
+    std::cout << "Audio underruns: " << audio_stats.underruns
+              << ", dropped samples: " << audio_stats.dropped << std::endl;
 
-    std::cerr << "Quitting: "
-              << static_cast<double>(display->frames()) /
-                     (std::chrono::duration_cast<std::chrono::seconds>(
-                          clockEnd - clockStart)
-                          .count())
-              << "fps" << std::endl;
+    if (probe != nullptr) {
+      probe->report(std::cout);
+    }
 
-    std::cout << "Cycles: " << +nes.state().cycle << std::endl;
-    std::cout << "Frames: " << display->frames() << std::endl;
+    if (capture_sink != nullptr) {
+      capture_sink->close();
+      auto c = capture_sink->stats();
+      std::cout << "Capture: " << c.frames << " frames written, " << c.dropped
+                << " dropped, at most " << c.max_queued << "/"
+                << sys::Capture::Slots << " queued" << std::endl;
+    }
   }
   SDL_Quit();
 
@@ -22,9 +22,16 @@ void AxROM::cartWrite(AddressT addr, DataT data) {
 
 AxROM::DataT AxROM::cartRead(AddressT addr) {
   assert(addr >= 0x8000);
+  return cart_.prgRom[prgRomOffset(addr)];
+}
+
+int32_t AxROM::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
+  }
   uint32_t bank = prgBankSelect * PRG_BANK_SIZE;
   AddressT offset = addr & PRG_ADDR_MASK;
-  return cart_.prgRom[bank + offset];
+  return bank + offset;
 }
 
 void AxROM::chrWrite(AddressT addr, DataT data) {
@@ -14,7 +14,7 @@ class NES;
 }
 
 namespace mapper {
-class AxROM : public NESMapperBase<AxROM> {
+class AxROM final : public NESMapperBase<AxROM> {
 public:
   AxROM(sys::NES &console, cart::Cartridge const &c, vid::Registers &reg,
         aud::Registers &areg, std::array<DataT, 0x100> &oam, ctrl::JoyPad &pad)
@@ -24,6 +24,7 @@ public:
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 
   uint8_t mirroring() const override { return mirror | 0b10; }
 
@@ -3,10 +3,13 @@
 #include "apu_registers.hpp"
 #include "cartridge.hpp"
 #include "joypad.hpp"
+#include "mappers/dma.hpp"
 #include "memory.hpp"
 #include "ppu_registers.hpp"
 
+#include <algorithm>
 #include <array>
+#include <functional>
 
 namespace sys {
 class NES;
@@ -22,6 +25,9 @@ public:
   virtual ~NESMapper() = default;
   virtual void write(AddressT, DataT) = 0;
   virtual DataT read(AddressT, bool dbg = false) = 0;
+  // A DMA unit's read (the DMC's sample fetch). Same result and bus effects
+  // as read(), but PRG ROM is served straight from the cartridge.
+  virtual DataT dmaRead(AddressT) = 0;
   virtual void ppu_write(AddressT, DataT) = 0;
   virtual DataT ppu_read(AddressT, bool dbg = false) = 0;
   virtual DataT palette_read(AddressT) const = 0;
@@ -30,12 +36,45 @@ public:
   virtual void oam_write(AddressT addr, DataT data) = 0;
   virtual uint8_t mirroring(void) const = 0;
   virtual bool setPpuABus(AddressT) = 0;
+  // PPUCTRL or PPUMASK was written
+  virtual void ppuConfigChanged() {}
   virtual void tick(uint16_t) = 0;
   virtual uint8_t openBus(void) const = 0;
+  // Offset into PRG ROM that a CPU address currently maps to, or -1 if the
+  // address isn't backed by PRG ROM. Virtual for the debugger's sake; the
+  // mappers themselves are final, so their own calls bind statically.
+  virtual int32_t prgRomOffset(AddressT) = 0;
   bool pendingIrq(void) const { return pending_irq_; };
+  // CPU cycles seen by the mapper, including those spent halted for DMA
+  unsigned long long cycle() const { return m2_count_; }
+  DMA &dma() { return dma_; }
+
+  enum Access : uint8_t {
+    WATCH_R = 0b01,
+    WATCH_W = 0b10,
+  };
+  using WatchHandler = std::function<void(AddressT, Access)>;
+
+  // Watchpoints are marked per 256B page. Accesses to unmarked pages cost a
+  // single table lookup; the handler resolves the exact address.
+  void setWatchHandler(WatchHandler h) { on_watch_ = std::move(h); }
+
+  // Called before any CPU access to the APU registers, so a lazily clocked
+  // APU can catch up first.
+  void setApuAccessHandler(std::function<void()> h) {
+    on_apu_access_ = std::move(h);
+  }
+  void markPage(uint8_t page, uint8_t access) { watch_pages_[page] = access; }
 
 protected:
   bool pending_irq_ = false;
+  // route CHR fetches through setPpuABus
+  bool track_a12_ = false;
+  unsigned long long m2_count_ = 0;
+  DMA dma_;
+  std::array<uint8_t, 0x100> watch_pages_ = {};
+  WatchHandler on_watch_;
+  std::function<void()> on_apu_access_;
 };
 
 template <class Derived> class NESMapperBase : public NESMapper {
@@ -77,15 +116,24 @@ public:
 
   // TODO(oren): magic numbers
   void write(AddressT addr, DataT data) override {
+    if (watch_pages_[addr >> 8] & WATCH_W) {
+      on_watch_(addr, WATCH_W);
+    }
     if (addr < 0x2000) {
       internal_[addr & 0x7FF] = data;
     } else if (addr < 0x4000) {
       ppu_reg_.write(CName(addr & 0x07), data, *this);
+      if ((addr & 0x07) == CName::PPUCTRL || (addr & 0x07) == CName::PPUMASK) {
+        ppuConfigChanged();
+      }
     } else if (addr == 0x4014) {
       oamDma(static_cast<AddressT>(data) << 8);
     } else if (addr == 0x4016) {
       joypad_.setStrobe(data & 0b1);
     } else if (addr < 0x4018) {
+      if (on_apu_access_) {
+        on_apu_access_();
+      }
       apu_reg_.write(AudCName(addr & 0x1F), data, *this);
     } else if (addr < 0x4020) {
       // some other i/o?
@@ -107,12 +155,15 @@ public:
         result = 0xFF;
       }
     } else if (addr == 0x4016 || addr == 0x4017) {
-      if (addr == 0x4016) {
+      if (addr == 0x4016 && !dbg) {
         result = joypad_.readNext();
       }
       result &= 0x0F;
       result |= (open_bus & 0xF0);
-    } else if (addr == 0x4015) {
+    } else if (addr == 0x4015 && !dbg) {
+      if (on_apu_access_) {
+        on_apu_access_();
+      }
       result = apu_reg_.read(AudCName(addr & 0x1F), *this);
     } else if (addr < 0x6000) {
       // TODO(OREN): rarely used, see docs
@@ -120,7 +171,13 @@ public:
     } else {
       result = static_cast<Derived *>(this)->cartRead(addr);
     }
-    open_bus = result;
+    // debugger peeks must not disturb the bus or trip watchpoints
+    if (!dbg) {
+      open_bus = result;
+      if (watch_pages_[addr >> 8] & WATCH_R) {
+        on_watch_(addr, WATCH_R);
+      }
+    }
     return result;
   }
 
@@ -135,7 +192,7 @@ public:
 
   DataT ppu_read(AddressT addr, bool dbg = false) override {
     if (addr < 0x2000) {
-      if (!dbg) {
+      if (!dbg && track_a12_) {
         setPpuABus(addr);
       }
       return static_cast<Derived *>(this)->chrRead(addr);
@@ -167,16 +224,50 @@ public:
   }
 
 protected:
-  unsigned long long m2_count_ = 0;
-
   void oamDma(AddressT base) {
+    std::array<DataT, 0x100> buf;
+    const DataT *src = dmaSource(base);
+    if (src == nullptr) {
+      for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = read(base | i);
+      }
+      src = buf.data();
+    } else {
+      open_bus = src[0xFF];
+    }
+    // OAM writes start at OAMADDR and wrap
     uint8_t oam_base = ppu_reg_.oamAddr() & (ppu_oam_.size() - 1);
-    for (size_t i = 0; i < ppu_oam_.size(); ++i) {
-      auto idx = (oam_base + i) & (ppu_oam_.size() - 1);
-      assert(idx < ppu_oam_.size());
-      ppu_oam_[idx] = read(base | i);
+    size_t split = ppu_oam_.size() - oam_base;
+    std::copy(src, src + split, ppu_oam_.begin() + oam_base);
+    std::copy(src + split, src + ppu_oam_.size(), ppu_oam_.begin());
+    dma_.oam(m2_count_);
+  }
+
+  DataT dmaRead(AddressT addr) override {
+    if (!(watch_pages_[addr >> 8] & WATCH_R)) {
+      auto off = static_cast<Derived *>(this)->Derived::prgRomOffset(addr);
+      if (off >= 0 && static_cast<size_t>(off) < cart_.prgRom.size()) {
+        open_bus = cart_.prgRom[off];
+        return open_bus;
+      }
+    }
+    return read(addr);
+  }
+
+  // Pages in internal RAM or PRG ROM are copied straight out of the backing
+  // store. Anything else (I/O, PRG RAM, watched pages) goes through read().
+  const DataT *dmaSource(AddressT base) {
+    if (watch_pages_[base >> 8] & WATCH_R) {
+      return nullptr;
+    } else if (base < 0x2000) {
+      return &internal_[base & 0x7FF];
+    }
+    auto off = static_cast<Derived *>(this)->Derived::prgRomOffset(base);
+    if (off >= 0 &&
+        static_cast<size_t>(off) + ppu_oam_.size() <= cart_.prgRom.size()) {
+      return &cart_.prgRom[off];
     }
-    ppu_reg_.signalOamDma();
+    return nullptr;
   }
 
   // TODO(oren): cleanup and add single-screen case (type trait??)
@@ -31,10 +31,17 @@ CNROM::DataT CNROM::cartRead(AddressT addr) {
       return 0;
     }
   } else {
-    return cart_.prgRom[addr & (cart_.prgRomSize - 1)];
+    return cart_.prgRom[prgRomOffset(addr)];
   }
 }
 
+int32_t CNROM::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
+  }
+  return addr & (cart_.prgRomSize - 1);
+}
+
 void CNROM::chrWrite(AddressT addr, DataT data) {
   uint32_t bank = (chrBankSelect)*0x2000;
   cart_.chrRam[bank + addr] = data;
@@ -14,7 +14,7 @@ class NES;
 }
 
 namespace mapper {
-class CNROM : public NESMapperBase<CNROM> {
+class CNROM final : public NESMapperBase<CNROM> {
 public:
   CNROM(sys::NES &console, cart::Cartridge const &c, vid::Registers &reg,
         aud::Registers &areg, std::array<DataT, 0x100> &oam, ctrl::JoyPad &pad)
@@ -24,5 +24,6 @@ public:
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 };
 } // namespace mapper
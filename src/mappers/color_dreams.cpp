@@ -23,11 +23,18 @@ ColorDreams::DataT ColorDreams::cartRead(AddressT addr) {
   if (addr < 0x8000) {
     assert(false);
   } else {
-    auto bank = PRG_BANK_SIZE * prgBankSelect;
-    auto offset = addr & (PRG_BANK_SIZE - 1);
-    return cart_.prgRom[bank + offset];
+    return cart_.prgRom[prgRomOffset(addr)];
   }
 }
+
+int32_t ColorDreams::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
+  }
+  auto bank = PRG_BANK_SIZE * prgBankSelect;
+  auto offset = addr & (PRG_BANK_SIZE - 1);
+  return bank + offset;
+}
 void ColorDreams::chrWrite(AddressT addr, DataT data) {
   assert(false);
   // no chr ram
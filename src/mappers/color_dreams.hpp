@@ -15,7 +15,7 @@ class NES;
 
 namespace mapper {
 
-class ColorDreams : public NESMapperBase<ColorDreams> {
+class ColorDreams final : public NESMapperBase<ColorDreams> {
 public:
   ColorDreams(sys::NES &console, cart::Cartridge const &c, vid::Registers &reg,
               aud::Registers &areg, std::array<DataT, 0x100> &oam,
@@ -26,6 +26,7 @@ public:
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 };
 
 } // namespace mapper
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mapper {
+
+// Cycle accounting for the 2A03 DMA unit.
+//
+// While a DMA is running the CPU is halted but the rest of the console keeps
+// going. Transfers only tally halted cycles here; the console drains them
+// right after the CPU cycle that started the transfer.
+//
+// CPU cycles alternate get (even) and put (odd), and DMA reads only happen on
+// get cycles:
+//   - OAM: halt, an alignment cycle if the halt lands on a put, then 256
+//     get/put pairs. 513 or 514 cycles.
+//   - DMC: halt, dummy, an alignment cycle if needed, then the read. 3 or 4
+//     cycles, or 2 when it steals a slot inside a running OAM transfer.
+//
+// NOTE(oren): the CPU can only be halted on a read cycle. A DMC fetch that
+// lands on a write (the pushes of JSR, BRK or an interrupt, the last cycles
+// of a read-modify-write) waits up to 3 more cycles on hardware. Nothing here
+// knows whether the CPU's next cycle is a write, so those halts start right
+// away regardless and come out up to 3 cycles early.
+class DMA {
+public:
+  static constexpr uint16_t OamCycles = 513;
+
+  void oam(unsigned long long cycle) {
+    uint16_t n = OamCycles + (cycle & 0b1);
+    halted_ += n;
+    oam_remaining_ += n;
+  }
+
+  void dmc(unsigned long long cycle) {
+    if (oam_remaining_ > 0) {
+      halted_ += 2;
+      oam_remaining_ += 2;
+    } else {
+      halted_ += 3 + (cycle & 0b1);
+    }
+  }
+
+  // Halted cycles that haven't been clocked through the console yet.
+  uint16_t take() {
+    auto n = halted_;
+    halted_ = 0;
+    return n;
+  }
+
+  // Retire one halted cycle
+  void clock() {
+    if (oam_remaining_ > 0) {
+      --oam_remaining_;
+    }
+  }
+
+  bool active() const { return halted_ > 0 || oam_remaining_ > 0; }
+
+private:
+  uint16_t halted_ = 0;
+  uint16_t oam_remaining_ = 0;
+};
+
+} // namespace mapper
@@ -21,7 +21,7 @@ void MMC1::cartWrite(AddressT addr, DataT data) {
   } else if (data & 0b10000000) {
     reset();
   } else if (last_sr_load_ == 0 ||
-             (console_.state().cycle - last_sr_load_) > 1) {
+             (console_.cycle() - last_sr_load_) > 1) {
     bool full = shiftReg_ & 0b1;
     shiftReg_ >>= 1;
     shiftReg_ |= ((data & 0b1) << 4);
@@ -30,7 +30,7 @@ void MMC1::cartWrite(AddressT addr, DataT data) {
       clearSR();
     }
   }
-  last_sr_load_ = console_.state().cycle;
+  last_sr_load_ = console_.cycle();
 }
 
 void MMC1::writeInternal(AddressT addr, uint8_t data) {
@@ -58,6 +58,14 @@ MMC1::DataT MMC1::cartRead(AddressT addr) {
     }
   }
 
+  return cart_.prgRom[prgRomOffset(addr)];
+}
+
+int32_t MMC1::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
+  }
+
   uint32_t bank = 0;
   AddressT offset = addr & PRG_ADDR_MASK;
 
@@ -90,7 +98,7 @@ MMC1::DataT MMC1::cartRead(AddressT addr) {
   }
 
   assert(bank + offset < cart_.prgRomSize);
-  return cart_.prgRom[bank + offset];
+  return bank + offset;
 }
 
 void MMC1::chrWrite(AddressT addr, DataT data) {
@@ -14,7 +14,7 @@ class NES;
 }
 
 namespace mapper {
-class MMC1 : public NESMapperBase<MMC1> {
+class MMC1 final : public NESMapperBase<MMC1> {
 
 public:
   explicit MMC1(sys::NES &console, cart::Cartridge const &c,
@@ -26,6 +26,7 @@ public:
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 
   uint8_t mirroring() const override {
     auto m = control_ & 0b11;
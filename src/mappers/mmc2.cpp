@@ -36,14 +36,21 @@ void MMC2::cartWrite(AddressT addr, DataT data) {
 }
 
 MMC2::DataT MMC2::cartRead(AddressT addr) {
-  uint32_t bank = 0;
-  AddressT offset = addr & PRG_ADDR_MASK;
   if (addr < 0x6000) {
     return 0;
   } else if (addr < 0x8000) {
     assert(false);
     // no prg ram here
     return cart_.prgRam[addr];
+  }
+  return cart_.prgRom[prgRomOffset(addr)];
+}
+
+int32_t MMC2::prgRomOffset(AddressT addr) {
+  uint32_t bank = 0;
+  AddressT offset = addr & PRG_ADDR_MASK;
+  if (addr < 0x8000) {
+    return -1;
   } else if (addr < 0xA000) {
     bank = PRG_BANK_SIZE * prgBankSelect;
   } else if (addr < 0xC000) {
@@ -53,7 +60,7 @@ MMC2::DataT MMC2::cartRead(AddressT addr) {
   } else {
     bank = cart_.prgRomSize - PRG_BANK_SIZE;
   }
-  return cart_.prgRom[bank + offset];
+  return bank + offset;
 }
 void MMC2::chrWrite(AddressT addr, DataT data) {
   assert(false);
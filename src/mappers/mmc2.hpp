@@ -15,7 +15,7 @@ class NES;
 
 namespace mapper {
 
-class MMC2 : public NESMapperBase<MMC2> {
+class MMC2 final : public NESMapperBase<MMC2> {
 public:
   MMC2(sys::NES &console, cart::Cartridge const &c, vid::Registers &reg,
        aud::Registers &areg, std::array<DataT, 0x100> &oam, ctrl::JoyPad &pad)
@@ -25,6 +25,7 @@ public:
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 
   uint8_t mirroring() const override {
     // NOTE(oren): for this mapper, 0 means vertical, 1 means horizontal
@@ -8,6 +8,16 @@ using CName = vid::Registers::CName;
 
 namespace mapper {
 
+namespace {
+constexpr uint16_t RiseDot = 257;
+constexpr uint16_t DotsPerLine = 341;
+constexpr uint16_t LinesPerFrame = 262;
+constexpr uint16_t PreRenderLine = 261;
+
+// visible and pre-render lines fetch sprites
+bool FetchLine(uint16_t line) { return line < 240 || line == PreRenderLine; }
+} // namespace
+
 void MMC3::cartWrite(AddressT addr, DataT data) {
   bool even = addr % 2 == 0;
   if (addr < 0x8000) {
@@ -55,6 +65,13 @@ MMC3::DataT MMC3::cartRead(AddressT addr) {
       return 0;
     }
   }
+  return cart_.prgRom[prgRomOffset(addr)];
+}
+
+int32_t MMC3::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
+  }
   const AddressT bank_size = 0x2000;
   AddressT offset = addr & (bank_size - 1);
   uint32_t bank = 0;
@@ -69,7 +86,7 @@ MMC3::DataT MMC3::cartRead(AddressT addr) {
   } else {
     bank = cart_.prgRomSize - bank_size;
   }
-  return cart_.prgRom[bank + offset];
+  return bank + offset;
 }
 
 void MMC3::chrWrite(AddressT addr, DataT data) {
@@ -182,32 +199,57 @@ bool MMC3::genIrq() {
   return false;
 }
 
+void MMC3::clockCounter() {
+  if (irqCounter_.reload(irqLatchVal_)) {
+    if (irqCounter_.val == 0 && irqEnabled_) {
+      genIrq();
+    }
+    return;
+  }
+
+  irqCounter_.val--;
+  if (irqCounter_.val == 0 && irqEnabled_) {
+    genIrq();
+  }
+}
+
 void MMC3::tick(uint16_t c) {
   m2_count_ += c;
+
+  if (predict_.active) {
+    // NOTE(oren): a DMA can clock us through several scanlines at once
+    while (m2_count_ >= riseClock()) {
+      clockCounter();
+      nextRise(predict_.line, RiseDot + 1);
+      ++predict_.rise;
+    }
+    return;
+  } else if (predict_.resync) {
+    tryPredicting();
+    if (predict_.active) {
+      return;
+    }
+  }
+
   if (a12_state_.timer == 0) {
     return;
   }
 
   unsigned long long time_since_change = m2_count_ - a12_state_.timer;
 
-  if (a12_state_.state == A12_STATE::HIGH && time_since_change == 2) {
+  if (a12_state_.state == A12_STATE::HIGH && time_since_change >= 2) {
     // stop the timer
     a12_state_.timer = 0;
-    if (irqCounter_.reload(irqLatchVal_)) {
-      if (irqCounter_.val == 0 && irqEnabled_) {
-        genIrq();
-      }
-      return;
-    }
-
-    irqCounter_.val--;
-    if (irqCounter_.val == 0 && irqEnabled_) {
-      genIrq();
-    }
+    clockCounter();
   }
 }
 
 bool MMC3::setPpuABus(AddressT val) {
+  // NOTE(oren): CHR fetches only come through here while edge tracking.
+  // While predicting they bypass it, so a call can only be the CPU reaching
+  // the bus through PPUADDR/PPUDATA, which may move the edge.
+  stopPredicting();
+
   bool prev = (ppuABus_ & 0x1000);
   bool next = (val & 0x1000);
   ppuABus_ = val;
@@ -220,4 +262,77 @@ bool MMC3::setPpuABus(AddressT val) {
   return false;
 }
 
+bool MMC3::standardLayout() {
+  return (ppu_reg_.showBackground() || ppu_reg_.showSprites()) &&
+         ppu_reg_.backgroundPTableAddr() == 0x0000 &&
+         ppu_reg_.spriteSize() == 8 && ppu_reg_.spritePTableAddr(0) == 0x1000;
+}
+
+void MMC3::tryPredicting() {
+  if (!standardLayout()) {
+    // only a PPUCTRL/PPUMASK write can change that, and it sets resync again
+    predict_.resync = false;
+    return;
+  }
+
+  auto line = ppu_reg_.scanline();
+  auto dot = ppu_reg_.cycle();
+
+  // Wait for edge tracking to settle. A high A12 is only safe to take over in
+  // vblank, where the pre-render line's background fetches will pull it low
+  // before the first rise.
+  if (a12_state_.state == A12_STATE::HIGH &&
+      (a12_state_.timer != 0 || FetchLine(line))) {
+    return;
+  }
+
+  predict_.odd = ppu_reg_.frames() & 0b1;
+  predict_.rise = 3 * m2_count_;
+  nextRise(line, dot);
+  predict_.active = true;
+  predict_.resync = false;
+  track_a12_ = false;
+}
+
+void MMC3::stopPredicting() {
+  if (!predict_.active) {
+    return;
+  }
+  predict_.active = false;
+  predict_.resync = true;
+  track_a12_ = true;
+
+  // Rebuild the A12 state the skipped fetches would have left behind: high
+  // from the first sprite fetch until the first background pattern fetch of
+  // the next tile (dot 325). A rise that hasn't been clocked yet keeps its
+  // filter timer.
+  auto line = ppu_reg_.scanline();
+  auto dot = ppu_reg_.cycle();
+  bool high = FetchLine(line) && RiseDot < dot && dot <= 325;
+  a12_state_.state = (high ? A12_STATE::HIGH : A12_STATE::LOW);
+  a12_state_.timer = 0;
+  if (high && predict_.line == line && m2_count_ < riseClock()) {
+    a12_state_.timer = riseClock() - 2;
+  }
+  ppuABus_ = (high ? 0x1000 : 0x0000);
+}
+
+void MMC3::nextRise(uint16_t line, uint16_t dot) {
+  // NOTE(oren): on odd frames the pre-render line skips dot 339 without
+  // processing it
+  while (!FetchLine(line) || dot > RiseDot) {
+    predict_.rise += DotsPerLine - dot;
+    if (line == PreRenderLine) {
+      if (predict_.odd && dot <= 339) {
+        --predict_.rise;
+      }
+      predict_.odd = !predict_.odd;
+    }
+    line = (line + 1) % LinesPerFrame;
+    dot = 0;
+  }
+  predict_.rise += RiseDot - dot;
+  predict_.line = line;
+}
+
 } // namespace mapper
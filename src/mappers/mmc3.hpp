@@ -13,17 +13,20 @@ class NES;
 
 namespace mapper {
 
-class MMC3 : public NESMapperBase<MMC3> {
+class MMC3 final : public NESMapperBase<MMC3> {
 public:
   MMC3(sys::NES &console, cart::Cartridge const &c, vid::Registers &reg,
        aud::Registers &areg, std::array<DataT, 0x100> &oam, ctrl::JoyPad &pad)
       : NESMapperBase<MMC3>(console, c, reg, areg, oam, pad),
-        mirroring_(cart_.mirroring ^ 0b1) {}
+        mirroring_(cart_.mirroring ^ 0b1) {
+    track_a12_ = true;
+  }
 
   void cartWrite(AddressT addr, DataT data);
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 
   uint8_t mirroring() const override {
     // NOTE(oren): for this mapper, 0 means vertical, 1 means horizontal
@@ -32,6 +35,11 @@ public:
   }
 
   bool setPpuABus(AddressT) override;
+  void ppuConfigChanged() override {
+    stopPredicting();
+    // the new layout may be one we can predict
+    predict_.resync = true;
+  }
 
 private:
   uint8_t mirroring_ = 0;
@@ -74,6 +82,31 @@ private:
     A12_STATE state = A12_STATE::LOW;
     unsigned long long timer = 0;
   } a12_state_ = {};
+
+  // With BG patterns at $0000, 8x8 sprites at $1000 and rendering on, A12
+  // rises exactly once per fetching scanline, on the first sprite fetch at dot
+  // 257. In that case the counter clocks are scheduled from the PPU position
+  // and CHR fetches bypass edge tracking entirely. Anything that could move
+  // the edge (PPUCTRL, PPUMASK, CPU access to PPUADDR/PPUDATA) drops us back
+  // to edge tracking until things settle.
+  struct {
+    bool active = false;
+    // try to start predicting on each tick until it works or the layout
+    // rules it out
+    bool resync = true;
+    // index of the next A12 rise, counted in PPU dots processed (3 per M2)
+    unsigned long long rise = 0;
+    uint16_t line = 0;
+    // frame parity at the pre-render line, for the odd frame dot skip
+    bool odd = false;
+  } predict_ = {};
+
+  bool standardLayout();
+  void tryPredicting();
+  void stopPredicting();
+  void nextRise(uint16_t line, uint16_t dot);
+  unsigned long long riseClock() const { return predict_.rise / 3 + 2; }
+  void clockCounter();
   void irqEnable(bool e);
 
   // TODO(oren): may want to remove for mmc6 compatibility
@@ -34,10 +34,17 @@ NROM::DataT NROM::cartRead(AddressT addr) {
       return 0;
     }
   } else {
-    return cart_.prgRom[addr & (cart_.prgRomSize - 1)];
+    return cart_.prgRom[prgRomOffset(addr)];
   }
 }
 
+int32_t NROM::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
+  }
+  return addr & (cart_.prgRomSize - 1);
+}
+
 void NROM::chrWrite(AddressT addr, DataT data) { cart_.chrRam[addr] = data; }
 NROM::DataT NROM::chrRead(AddressT addr) {
   auto &chrMem = (cart_.chrRamSize ? cart_.chrRam : cart_.chrRom);
@@ -19,15 +19,22 @@ UxROM::DataT UxROM::cartRead(AddressT addr) {
   if (addr < 0x8000) {
     // TODO(oren): not mapped
     return 0;
+  }
+  return cart_.prgRom[prgRomOffset(addr)];
+}
+
+int32_t UxROM::prgRomOffset(AddressT addr) {
+  if (addr < 0x8000) {
+    return -1;
   } else if (addr < 0xC000) {
     // switchable PRG ROM bank
     uint32_t bank = (prgBankSelect)*0x4000;
     uint16_t offset = addr & (0x4000 - 1);
-    return cart_.prgRom[bank + offset];
+    return bank + offset;
   } else { // 0xC000 <= addr <= 0xFFFF
     uint32_t fixed_bank = cart_.prgRomSize - 0x4000;
     uint16_t offset = addr & (0x4000 - 1);
-    return cart_.prgRom[fixed_bank + offset];
+    return fixed_bank + offset;
   }
 }
 
@@ -14,7 +14,7 @@ class NES;
 }
 
 namespace mapper {
-class UxROM : public NESMapperBase<UxROM> {
+class UxROM final : public NESMapperBase<UxROM> {
 public:
   explicit UxROM(sys::NES &console, cart::Cartridge const &c,
                  vid::Registers &reg, aud::Registers &areg,
@@ -25,5 +25,6 @@ public:
   DataT cartRead(AddressT addr);
   void chrWrite(AddressT addr, DataT data);
   DataT chrRead(AddressT addr);
+  int32_t prgRomOffset(AddressT addr) override;
 };
 } // namespace mapper
@@ -0,0 +1,192 @@
+#include "ntsc_filter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace vid {
+
+namespace {
+constexpr double Pi = 3.14159265358979323846;
+
+// Composite voltages relative to sync, see the NESdev page
+constexpr float Black = 0.518f;
+constexpr float White = 1.962f;
+constexpr float Attenuation = 0.746f;
+constexpr std::array<float, 8> Levels = {
+    0.350f, 0.518f, 0.962f, 1.550f, // signal low
+    1.094f, 1.506f, 1.962f, 1.962f, // signal high
+};
+
+// decoder's phase offset from the colorburst, in subcarrier twelfths
+constexpr double Hue = 3.9;
+// Picture controls, fitted so that a flat field of each color comes out
+// close to the stock palette (data/2c02.palette)
+constexpr double Saturation = 1.4;
+constexpr double Contrast = 0.95;
+constexpr double Brightness = -10.0;
+
+// The PPU's output for pixel p at subcarrier phase (0-11), black to white
+// normalized to 0 to 1
+float signal(Pixel p, int phase) {
+  int color = p & 0x0F;
+  int level = (p >> 4) & 0b11;
+  int emphasis = p >> 6;
+  if (color > 13) {
+    level = 1;
+  }
+  float low = Levels[level];
+  float high = Levels[4 + level];
+  if (color == 0) {
+    low = high;
+  } else if (color > 12) {
+    high = low;
+  }
+
+  auto in_phase = [phase](int c) { return (c + phase) % 12 < 6; };
+  float s = in_phase(color) ? high : low;
+  if (((emphasis & 0b001) && in_phase(0)) ||
+      ((emphasis & 0b010) && in_phase(4)) ||
+      ((emphasis & 0b100) && in_phase(8))) {
+    s *= Attenuation;
+  }
+  return (s - Black) / (White - Black);
+}
+} // namespace
+
+NtscFilter::NtscFilter(int scale, size_t threads)
+    : scale_(scale), pool_(threads) {
+  if (scale < 2 || scale > 3) {
+    throw std::invalid_argument("NTSC filter scale must be 2 or 3");
+  }
+
+  const int outs = 3 * scale_;
+  kernels_.resize(512 * 3 * outs * Lanes);
+  for (Pixel p = 0; p < 512; ++p) {
+    for (int k = 0; k < 3; ++k) {
+      // an input dot's samples start at phase 4k
+      int phase = 4 * k;
+      float *out = kernels_.data() + (p * 3 + k) * outs * Lanes;
+      for (int t = 0; t < outs; ++t) {
+        // center of the output dot, in samples from the start of this dot.
+        // t counts from the first output of the previous dot.
+        double c = (t - scale_ + 0.5) * 8 / scale_;
+        double y = 0.0, i = 0.0, q = 0.0;
+        for (int s = 0; s < 8; ++s) {
+          // one subcarrier cycle (12 samples) either side
+          if (s + 0.5 < c - 6 || s + 0.5 >= c + 6) {
+            continue;
+          }
+          double level = signal(p, (phase + s) % 12) / 12.0;
+          double theta = Pi * (phase + s + Hue) / 6;
+          y += level;
+          i += Saturation * level * std::cos(theta);
+          q += Saturation * level * std::sin(theta);
+        }
+        // YIQ to RGB (FCC). Every output dot sums exactly three
+        // contributions, so each carries a third of the brightness offset.
+        double gain = 255 * Contrast;
+        double bias = Brightness / 3;
+        out[t * Lanes + 2] = bias + gain * (y + 0.946882 * i + 0.623557 * q);
+        out[t * Lanes + 1] = bias + gain * (y - 0.274788 * i - 0.635691 * q);
+        out[t * Lanes + 0] = bias + gain * (y - 1.108545 * i + 1.709007 * q);
+        out[t * Lanes + 3] = 0.0f;
+      }
+    }
+  }
+}
+
+void NtscFilter::run(FrameView frame, uint8_t phase, size_t first,
+                     size_t last, uint32_t *out, size_t pitch) {
+  size_t bands = (last - first + Band - 1) / Band;
+  pool_.run(bands, [&](size_t b) {
+    size_t begin = first + b * Band;
+    size_t end = std::min(begin + Band, last);
+    for (size_t y = begin; y < end; ++y) {
+      auto row = reinterpret_cast<uint32_t *>(
+          reinterpret_cast<uint8_t *>(out) + (y - first) * pitch);
+      const Pixel *in = frame.data() + y * WIDTH;
+      // each scanline is 341 * 8 samples, 4 more than a whole number of
+      // subcarrier cycles
+      uint8_t row_phase = (phase + 4 * y) % 12;
+      if (simd_) {
+        filterRow<true>(in, row_phase, row);
+      } else {
+        filterRow<false>(in, row_phase, row);
+      }
+    }
+  });
+}
+
+template <bool Simd>
+void NtscFilter::filterRow(const Pixel *row, uint8_t row_phase,
+                           uint32_t *out) const {
+  const int s = scale_;
+  // a dot's samples start 8 phases after the previous dot's, so its phase
+  // index steps by 2 (mod 3). Offset so j = -1 stays non-negative.
+  auto at = [&](int j) {
+    Pixel p = (j < 0 || j >= static_cast<int>(WIDTH)) ? 0x0F : row[j];
+    return kernel(p, (row_phase / 4 + 2 * j + 6) % 3);
+  };
+
+  // three dots' worth of outputs per input dot, at most 3 per dot
+  alignas(16) std::array<float, WIDTH * 3 * Lanes> acc;
+  const float *prev = at(-1);
+  const float *curr = at(0);
+  for (int j = 0; j < static_cast<int>(WIDTH); ++j) {
+    const float *next = at(j + 1);
+    for (int r = 0; r < s; ++r) {
+      float *dst = acc.data() + (j * s + r) * Lanes;
+      const float *a = prev + (2 * s + r) * Lanes;
+      const float *b = curr + (s + r) * Lanes;
+      const float *c = next + r * Lanes;
+#if defined(__SSE2__)
+      if (Simd) {
+        _mm_store_ps(dst,
+                     _mm_add_ps(_mm_add_ps(_mm_load_ps(a), _mm_load_ps(b)),
+                                _mm_load_ps(c)));
+        continue;
+      }
+#endif
+      for (size_t l = 0; l < Lanes; ++l) {
+        dst[l] = a[l] + b[l] + c[l];
+      }
+    }
+    prev = curr;
+    curr = next;
+  }
+
+  // Round, saturate and pack to ARGB8888
+  const size_t n = WIDTH * s;
+  size_t x = 0;
+#if defined(__SSE2__)
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+  for (; Simd && x + 4 <= n; x += 4) {
+    const float *src = acc.data() + x * Lanes;
+    __m128i p0 = _mm_cvtps_epi32(_mm_load_ps(src));
+    __m128i p1 = _mm_cvtps_epi32(_mm_load_ps(src + 4));
+    __m128i p2 = _mm_cvtps_epi32(_mm_load_ps(src + 8));
+    __m128i p3 = _mm_cvtps_epi32(_mm_load_ps(src + 12));
+    __m128i lo = _mm_packs_epi32(p0, p1);
+    __m128i hi = _mm_packs_epi32(p2, p3);
+    __m128i px = _mm_or_si128(_mm_packus_epi16(lo, hi), alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), px);
+  }
+#endif
+  for (; x < n; ++x) {
+    const float *src = acc.data() + x * Lanes;
+    uint32_t px = 0xFF000000u;
+    for (int l = 0; l < 3; ++l) {
+      float v = std::clamp(src[l], 0.0f, 255.0f);
+      px |= static_cast<uint32_t>(std::nearbyint(v)) << (8 * l);
+    }
+    out[x] = px;
+  }
+}
+
+} // namespace vid
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "frame_queue.hpp"
+#include "video_filter.hpp"
+#include "worker_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vid {
+
+// NTSC composite video, after https://www.nesdev.org/wiki/NTSC_video
+//
+// Models the PPU's composite output from the raw 9 bit pixels (a square wave
+// per color, 8 samples a dot against a 12 phase color subcarrier, emphasis
+// attenuating parts of the wave) and a TV decoding it over a window of one
+// subcarrier cycle. Luma and chroma bleed into each other, which gives the
+// familiar fringing and artifact colors, and the subcarrier phase shifts
+// from frame to frame, so the artifacts crawl.
+//
+// The decoder is linear, so each output dot is a sum of contributions from
+// the three nearest input dots. A contribution depends only on the dot's
+// value, its subcarrier phase (one of three) and the output position, so
+// they're all precomputed in RGB and filtering is table lookups and adds.
+class NtscFilter : public VideoFilter {
+public:
+  // scale is output dots per input dot (2 or 3). Rows are split across the
+  // given number of worker threads plus the calling thread.
+  explicit NtscFilter(int scale, size_t threads = 2);
+
+  const char *name() const override { return "ntsc"; }
+  size_t scaleX() const override { return scale_; }
+  size_t scaleY() const override { return 1; }
+  bool phaseDependent() const override { return true; }
+
+  void run(FrameView frame, uint8_t phase, size_t first, size_t last,
+           uint32_t *out, size_t pitch) override;
+
+  // SSE2 is used where the build has it. The portable code gives the same
+  // output, so turning it off is only useful to check one against the other.
+  void setSimd(bool on) { simd_ = on; }
+
+private:
+  // rows per job handed to the pool
+  static constexpr size_t Band = 16;
+  // per output dot: B, G, R and an unused lane
+  static constexpr size_t Lanes = 4;
+
+  template <bool Simd>
+  void filterRow(const Pixel *row, uint8_t row_phase, uint32_t *out) const;
+  const float *kernel(Pixel p, int k) const {
+    return kernels_.data() + (p * 3 + k) * 3 * scale_ * Lanes;
+  }
+
+  int scale_;
+  // [pixel][phase][3 * scale output dots][Lanes]. An input dot's
+  // contribution to the outputs of the dot before it, itself and the one
+  // after it.
+  std::vector<float> kernels_;
+  bool simd_ = true;
+  util::WorkerPool pool_;
+};
+
+} // namespace vid
@@ -0,0 +1,69 @@
+#include "output_filter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace aud {
+
+namespace {
+constexpr double Pi = 3.14159265358979323846;
+
+double rc(double cutoff) { return 1.0 / (2.0 * Pi * cutoff); }
+} // namespace
+
+OutputFilter::OutputFilter(int sample_rate) {
+  double dt = 1.0 / sample_rate;
+  hp90_.a = static_cast<float>(rc(90.0) / (rc(90.0) + dt));
+  hp440_.a = static_cast<float>(rc(440.0) / (rc(440.0) + dt));
+  lp14k_.b = static_cast<float>(dt / (rc(14000.0) + dt));
+}
+
+void OutputFilter::process(const float *in, int16_t *out, size_t n) {
+  std::array<float, Block> buf;
+  for (size_t base = 0; base < n; base += Block) {
+    size_t len = std::min(Block, n - base);
+    // NOTE(oren): each filter depends on its own last output, so this part is
+    // inherently serial. It's a handful of flops per sample next to the
+    // conversion below.
+    for (size_t i = 0; i < len; ++i) {
+      buf[i] = lp14k_(hp440_(hp90_(in[base + i])));
+    }
+    convert(buf.data(), out + base, len);
+  }
+}
+
+void OutputFilter::reset() {
+  hp90_ = {hp90_.a};
+  hp440_ = {hp440_.a};
+  lp14k_ = {lp14k_.b};
+}
+
+// Round to nearest and saturate to int16. The SSE2 and scalar paths agree
+// bit for bit (both round half to even).
+void OutputFilter::convert(const float *in, int16_t *out, size_t n) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 min = _mm_set1_ps(-32768.0f);
+  const __m128 max = _mm_set1_ps(32767.0f);
+  auto load = [&](size_t j) {
+    return _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + j), min), max);
+  };
+  for (; i + 8 <= n; i += 8) {
+    __m128i lo = _mm_cvtps_epi32(load(i));
+    __m128i hi = _mm_cvtps_epi32(load(i + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_packs_epi32(lo, hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    float s = std::clamp(in[i], -32768.0f, 32767.0f);
+    out[i] = static_cast<int16_t>(std::nearbyint(s));
+  }
+}
+
+} // namespace aud
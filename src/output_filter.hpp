@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aud {
+
+// The console's analog output stage, applied to the synthesized signal a
+// block at a time: a pair of first-order high-passes (90Hz and 440Hz, which
+// also strip the APU's DC offset) and a first-order low-pass (14kHz), then
+// conversion to int16 with saturation.
+// See https://www.nesdev.org/wiki/APU_Mixer
+class OutputFilter {
+public:
+  explicit OutputFilter(int sample_rate);
+
+  void process(const float *in, int16_t *out, size_t n);
+  void reset();
+
+private:
+  // samples filtered per pass before conversion
+  static constexpr size_t Block = 256;
+
+  struct HighPass {
+    float a;
+    float prev_in = 0.0f;
+    float prev_out = 0.0f;
+
+    float operator()(float x) {
+      prev_out = a * (prev_out + x - prev_in);
+      prev_in = x;
+      return prev_out;
+    }
+  };
+
+  struct LowPass {
+    float b;
+    float prev_out = 0.0f;
+
+    float operator()(float x) {
+      prev_out += b * (x - prev_out);
+      return prev_out;
+    }
+  };
+
+  static void convert(const float *in, int16_t *out, size_t n);
+
+  HighPass hp90_;
+  HighPass hp440_;
+  LowPass lp14k_;
+};
+
+} // namespace aud
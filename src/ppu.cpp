@@ -8,6 +8,7 @@
 namespace vid {
 
 std::array<std::array<uint8_t, 3>, 64> PPU::SystemPalette = {};
+std::array<Rgb, 512> PPU::FullPalette = {};
 
 void LoadSystemPalette(const std::string &fname) {
   std::ifstream istrm(fname, std::ios::binary);
@@ -18,11 +19,30 @@ void LoadSystemPalette(const std::string &fname) {
               std::begin(vid::PPU::SystemPalette[i]));
     ++i;
   }
+
+  constexpr int amt = 16;
+  for (size_t p = 0; p < PPU::FullPalette.size(); ++p) {
+    auto rgb = PPU::SystemPalette[p & 0x3F];
+    for (size_t i = 0; i < rgb.size(); ++i) {
+      int16_t val = static_cast<int16_t>(rgb[i]);
+      for (size_t j = 0; j < rgb.size(); ++j) {
+        int emph = (p >> (6 + j)) & 0b1;
+        if (j == i) {
+          val += amt * emph;
+          val = std::min(val, static_cast<int16_t>(0xFF));
+        } else {
+          val -= amt * emph;
+          val = std::max(val, static_cast<int16_t>(0));
+        }
+      }
+      PPU::FullPalette[p][i] = static_cast<uint8_t>(val);
+    }
+  }
 }
 
 PPU::PPU(mapper::NESMapper &mapper, Registers &registers,
-         std::array<uint8_t, 256> &oam)
-    : mapper_(mapper), registers_(registers), oam_(oam) {}
+         std::array<uint8_t, 256> &oam, FrameQueue &frames)
+    : frames_(frames), mapper_(mapper), registers_(registers), oam_(oam) {}
 
 void PPU::step(uint16_t cycles, bool &nmi) {
   while (cycles-- > 0) {
@@ -57,10 +77,25 @@ void PPU::step(uint16_t cycles, bool &nmi) {
       }
     }
 
+    if (registers_.cycle() == 256 && registers_.scanline() < HEIGHT) {
+      frames_.finishRow(registers_.scanline());
+    }
+
     registers_.tick();
+    if (registers_.scanline() == 241 && registers_.cycle() == 0) {
+      frames_.publish(phase_);
+    }
     if (rendering() && registers_.scanline() == 261 &&
         registers_.cycle() == 339 && (registers_.frames() & 0b1)) {
       registers_.tick();
+      short_frame_ = true;
+    }
+    if (registers_.scanline() == 0 && registers_.cycle() == 0) {
+      // NOTE(oren): a dot is 8 samples of a 12 phase color subcarrier, so a
+      // 262 * 341 dot frame advances the phase by 4. A short frame (one dot
+      // less) advances it by 8 (mod 12).
+      phase_ = (phase_ + (short_frame_ ? 8 : 4)) % 12;
+      short_frame_ = false;
     }
   }
 }
@@ -94,6 +129,9 @@ void PPU::handleBackground(bool pre_render) {
       renderBgPixel(dot_x, dot_y);
     } else {
       bg_zero_ = true;
+      if (!pre_render) {
+        blank_pixel(dot_x, dot_y);
+      }
     }
     backgroundSR_.Shift();
 
@@ -340,7 +378,7 @@ void PPU::renderBgPixel(int abs_x, int abs_y) {
   }
   bg_zero_ = (value == 0);
   auto c = palette[value] & 0x3F;
-  set_pixel(abs_x, abs_y, SystemPalette[c]);
+  set_pixel(abs_x, abs_y, c);
 }
 
 void PPU::renderSpritePixel(int abs_x, int abs_y) {
@@ -367,7 +405,7 @@ void PPU::renderSpritePixel(int abs_x, int abs_y) {
       if (value > 0 && !filled) {
         if (Priority(sprite.s.attrs.s.priority) == Priority::FG || bg_zero_) {
           auto c = palette[value] & 0x3F;
-          set_pixel(abs_x, abs_y, SystemPalette[c]);
+          set_pixel(abs_x, abs_y, c);
         }
         filled = true;
       }
@@ -381,9 +419,14 @@ void PPU::directColorControl() {
   auto addr = registers_.vRamAddr();
   int dot_y = registers_.scanline();
   int dot_x = registers_.cycle() - 1;
-  if (dot_y < 240 && dot_x < 256 && 0x3F00 <= addr && addr < 0x4000) {
+  if (dot_y >= 240 || dot_x < 0 || dot_x >= 256) {
+    return;
+  }
+  if (0x3F00 <= addr && addr < 0x4000) {
     auto c = mapper_.palette_read(addr) & 0x3F;
-    set_pixel(dot_x, dot_y, SystemPalette[c]);
+    set_pixel(dot_x, dot_y, c);
+  } else {
+    blank_pixel(dot_x, dot_y);
   }
 }
 
@@ -441,33 +484,25 @@ inline std::array<uint8_t, 4> PPU::spritePalette(uint8_t pidx) {
   };
 }
 
-void PPU::set_pixel(uint8_t x, uint8_t y, std::array<uint8_t, 3> rgb) {
+void PPU::set_pixel(uint8_t x, uint8_t y, uint8_t color) {
   size_t pi = y * WIDTH + x;
-
-  std::array<int, 3> emph = {
-      registers_.emphasizeRed() ? 1 : 0,
-      registers_.emphasizeGreen() ? 1 : 0,
-      registers_.emphasizeBlue() ? 1 : 0,
-  };
-
-  constexpr int amt = 16;
-
-  for (size_t i = 0; i < rgb.size(); ++i) {
-    int16_t val = static_cast<int16_t>(rgb[i]);
-    for (size_t j = 0; j < emph.size(); ++j) {
-      if (j == i) {
-        val += amt * emph[j];
-        val = std::min(val, static_cast<int16_t>(0xFF));
-      } else {
-        val -= amt * emph[j];
-        val = std::max(val, static_cast<int16_t>(0));
-      }
-    }
-    rgb[i] = static_cast<uint8_t>(val);
+  Pixel emph = (registers_.emphasizeRed() ? 0b001 : 0) |
+               (registers_.emphasizeGreen() ? 0b010 : 0) |
+               (registers_.emphasizeBlue() ? 0b100 : 0);
+  auto &frame = frames_.back();
+  if (pi < frame.size()) {
+    frame[pi] = (emph << 6) | (color & 0x3F);
   }
+}
 
-  if (pi < framebuf_.size()) {
-    std::copy(std::begin(rgb), std::end(rgb), std::begin(framebuf_[pi]));
+// NOTE(oren): frame buffers are recycled rather than cleared, so dots the
+// PPU doesn't draw (rendering disabled, or background off) are explicitly
+// blacked out. No color emphasis, which is what a cleared frame used to show.
+void PPU::blank_pixel(uint8_t x, uint8_t y) {
+  size_t pi = y * WIDTH + x;
+  auto &frame = frames_.back();
+  if (pi < frame.size()) {
+    frame[pi] = Black;
   }
 }
 
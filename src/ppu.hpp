@@ -1,5 +1,6 @@
 #pragma once
 
+#include "frame_queue.hpp"
 #include "mappers/base_mapper.hpp"
 #include "memory.hpp"
 #include "ppu_registers.hpp"
@@ -13,8 +14,6 @@ class NESDebugger;
 }
 
 namespace vid {
-constexpr size_t WIDTH = 256;
-constexpr size_t HEIGHT = 240;
 
 void LoadSystemPalette(const std::string &fname);
 
@@ -45,7 +44,6 @@ public:
 private:
   using AddressT = uint16_t;
   using DataT = uint8_t;
-  using FrameBuffer = std::array<std::array<uint8_t, 3>, WIDTH * HEIGHT>;
 
   enum class Priority {
     FG = 0,
@@ -63,12 +61,7 @@ private:
 
 public:
   PPU(mapper::NESMapper &mapper, Registers &registers,
-      std::array<uint8_t, 256> &oam);
-
-  FrameBuffer const &frameBuffer() { return framebuf_; }
-  void clearFrame() {
-    std::fill(&framebuf_[0][0], &framebuf_[0][0] + framebuf_.size() * 3, 0x00);
-  }
+      std::array<uint8_t, 256> &oam, FrameQueue &frames);
 
   void step(uint16_t cycles, bool &nmi);
 
@@ -82,7 +75,11 @@ private:
   void handleSprites(bool pre_render);
 
   void vBlankLine();
-  void set_pixel(uint8_t x, uint8_t y, std::array<uint8_t, 3> rgb);
+  // black, for dots the PPU doesn't draw
+  static constexpr Pixel Black = 0x0F;
+
+  void set_pixel(uint8_t x, uint8_t y, uint8_t color);
+  void blank_pixel(uint8_t x, uint8_t y);
   std::array<uint8_t, 4> bgPalette();
   std::array<uint8_t, 4> spritePalette(uint8_t pidx);
 
@@ -159,7 +156,7 @@ private:
     }
   }
 
-  FrameBuffer framebuf_{};
+  FrameQueue &frames_;
   mapper::NESMapper &mapper_;
   Registers &registers_;
   std::array<uint8_t, 256> &oam_;
@@ -175,11 +172,17 @@ private:
   uint8_t sec_oam_n_ = 0;
   bool sec_oam_write_enable_ = false;
 
+  // subcarrier phase at the start of the current frame, see FrameQueue
+  uint8_t phase_ = 0;
+  bool short_frame_ = false;
+
   friend void LoadSystemPalette(const std::string &fname);
   friend class sys::NESDebugger;
 
 public:
   static std::array<std::array<uint8_t, 3>, 64> SystemPalette;
+  // SystemPalette for every combination of emphasis bits, indexed by Pixel
+  static std::array<Rgb, 512> FullPalette;
 };
 
 } // namespace vid
@@ -201,12 +201,6 @@ bool Registers::handleNmi() {
   return tmp;
 }
 
-uint16_t Registers::oamCycles() {
-  auto v = oam_cycles_;
-  oam_cycles_ = 0;
-  return v;
-}
-
 const array<bool, 8> Registers::Writeable = {true, true, false, true,
                                              true, true, true,  true};
 const array<bool, 8> Registers::Readable = {false, false, true,  false,
@@ -155,9 +155,6 @@ public:
   void clearWritePending() { write_pending_ = false; }
   bool handleNmi();
 
-  void signalOamDma();
-  uint16_t oamCycles();
-
 private:
   uint16_t cycle_ = 0;
   uint16_t scanline_ = 261;
@@ -256,7 +253,6 @@ private:
   uint8_t write_value_ = 0x00;
   bool read_pending_ = false;
   bool nmi_pending_ = false;
-  uint16_t oam_cycles_ = 0;
 
   const static std::array<bool, 8> Writeable;
   const static std::array<bool, 8> Readable;
@@ -343,7 +339,4 @@ inline void Registers::incVRamAddr() {
 inline bool Registers::writePending() { return write_pending_; }
 inline bool Registers::readPending() { return read_pending_; }
 
-// TODO(oren): handle 514 (odd CPU cycle) case
-inline void Registers::signalOamDma() { oam_cycles_ = 513 * 3; }
-
 } // namespace vid
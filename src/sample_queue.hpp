@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace aud {
+
+// Finished samples on their way from the APU to the audio device.
+//
+// Wait-free single-producer/single-consumer ring. The emulator pushes a block
+// at the end of each synthesis frame and the device callback pops whatever it
+// needs; neither side ever blocks the other, so a preempted emulation thread
+// can't stall the audio thread (or vice versa).
+//
+// Each index is written by exactly one side and lives on its own cache line,
+// along with that side's statistics.
+class SampleQueue {
+public:
+  static constexpr size_t DefaultCapacity = 1 << 14;
+
+  struct Stats {
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+    // samples discarded because the ring was full
+    uint64_t dropped = 0;
+    // callbacks that found fewer samples than they asked for
+    uint64_t underruns = 0;
+    size_t min_fill = 0;
+    size_t max_fill = 0;
+  };
+
+  explicit SampleQueue(size_t capacity = DefaultCapacity)
+      : buf_(capacity), mask_(capacity - 1) {
+    if (capacity == 0 || (capacity & mask_) != 0) {
+      throw std::invalid_argument("SampleQueue capacity must be a power of 2");
+    }
+  }
+
+  SampleQueue(const SampleQueue &) = delete;
+  SampleQueue &operator=(const SampleQueue &) = delete;
+
+  // Producer side. Returns the number of samples accepted; anything beyond
+  // the free space is dropped and counted.
+  size_t push(const int16_t *samples, size_t n) {
+    auto head = prod_.head.load(std::memory_order_relaxed);
+    auto tail = cons_.tail.load(std::memory_order_acquire);
+    size_t fill = head - tail;
+    size_t count = std::min(n, buf_.size() - fill);
+    copyIn(head, samples, count);
+    prod_.head.store(head + count, std::memory_order_release);
+
+    prod_.pushed.store(prod_.pushed.load(std::memory_order_relaxed) + count,
+                       std::memory_order_relaxed);
+    if (count < n) {
+      prod_.dropped.store(prod_.dropped.load(std::memory_order_relaxed) +
+                              (n - count),
+                          std::memory_order_relaxed);
+    }
+    if (fill + count > prod_.max_fill.load(std::memory_order_relaxed)) {
+      prod_.max_fill.store(fill + count, std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  // Consumer side. Returns the number of samples written to out.
+  size_t pop(int16_t *out, size_t n) {
+    auto tail = cons_.tail.load(std::memory_order_relaxed);
+    auto head = prod_.head.load(std::memory_order_acquire);
+    size_t fill = head - tail;
+    size_t count = std::min(n, fill);
+    copyOut(tail, out, count);
+    cons_.tail.store(tail + count, std::memory_order_release);
+
+    cons_.popped.store(cons_.popped.load(std::memory_order_relaxed) + count,
+                       std::memory_order_relaxed);
+    if (count < n) {
+      cons_.underruns.store(cons_.underruns.load(std::memory_order_relaxed) +
+                                1,
+                            std::memory_order_relaxed);
+    }
+    if (fill < cons_.min_fill.load(std::memory_order_relaxed)) {
+      cons_.min_fill.store(fill, std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  // Approximate when read from a third thread.
+  size_t size() const {
+    return prod_.head.load(std::memory_order_acquire) -
+           cons_.tail.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return buf_.size(); }
+
+  Stats stats() const {
+    Stats s;
+    s.pushed = prod_.pushed.load(std::memory_order_relaxed);
+    s.dropped = prod_.dropped.load(std::memory_order_relaxed);
+    s.max_fill = prod_.max_fill.load(std::memory_order_relaxed);
+    s.popped = cons_.popped.load(std::memory_order_relaxed);
+    s.underruns = cons_.underruns.load(std::memory_order_relaxed);
+    s.min_fill = std::min(cons_.min_fill.load(std::memory_order_relaxed),
+                          s.max_fill);
+    return s;
+  }
+
+private:
+  // NOTE(oren): std::hardware_destructive_interference_size would be the
+  // portable spelling, but GCC warns that its value isn't ABI-stable
+  static constexpr size_t CacheLine = 64;
+
+  void copyIn(size_t pos, const int16_t *src, size_t n) {
+    size_t start = pos & mask_;
+    size_t first = std::min(n, buf_.size() - start);
+    std::memcpy(buf_.data() + start, src, first * sizeof(int16_t));
+    std::memcpy(buf_.data(), src + first, (n - first) * sizeof(int16_t));
+  }
+
+  void copyOut(size_t pos, int16_t *dst, size_t n) const {
+    size_t start = pos & mask_;
+    size_t first = std::min(n, buf_.size() - start);
+    std::memcpy(dst, buf_.data() + start, first * sizeof(int16_t));
+    std::memcpy(dst + first, buf_.data(), (n - first) * sizeof(int16_t));
+  }
+
+  // indices increase monotonically and are masked on access, so
+  // head - tail is always the fill level, even across wraparound
+  struct alignas(CacheLine) {
+    std::atomic<size_t> head = 0;
+    std::atomic<uint64_t> pushed = 0;
+    std::atomic<uint64_t> dropped = 0;
+    std::atomic<size_t> max_fill = 0;
+  } prod_;
+
+  struct alignas(CacheLine) {
+    std::atomic<size_t> tail = 0;
+    std::atomic<uint64_t> popped = 0;
+    std::atomic<uint64_t> underruns = 0;
+    std::atomic<size_t> min_fill = std::numeric_limits<size_t>::max();
+  } cons_;
+
+  std::vector<int16_t> buf_;
+  size_t mask_;
+};
+
+} // namespace aud
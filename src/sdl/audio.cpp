@@ -1,8 +1,8 @@
 #include "audio.hpp"
-#include "gen_audio.hpp"
 
 #include <SDL.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
@@ -16,17 +16,18 @@ Audio::~Audio() {
   delete audio_spec_;
 }
 
-void Audio::init() {
+void Audio::open(aud::SampleQueue &q, int sample_rate) {
   SDL_AudioSpec want;
   SDL_zero(want);
   SDL_zero(*audio_spec_);
 
-  want.freq = aud::SampleRate;
+  want.freq = sample_rate;
   want.format = AUDIO_S16LSB;
   want.channels = 1;
   want.samples = buffer_size_;
 
   want.callback = &Audio::audio_callback;
+  want.userdata = &q;
 
   audio_device_ = SDL_OpenAudioDevice(NULL, 0, &want, audio_spec_, 0);
 
@@ -38,13 +39,14 @@ void Audio::init() {
   SDL_PauseAudioDevice(audio_device_, 0);
 }
 
-void Audio::audio_callback(void *unused, uint8_t *byte_stream,
+void Audio::audio_callback(void *userdata, uint8_t *byte_stream,
                            int byte_stream_length) {
-  memset(byte_stream, 0, byte_stream_length);
-
-  for (const auto &c : aud::Generator::Channels()) {
-    c->write_stream(byte_stream, byte_stream_length);
-  }
+  auto &q = *static_cast<aud::SampleQueue *>(userdata);
+  auto *stream = reinterpret_cast<int16_t *>(byte_stream);
+  size_t len = byte_stream_length / sizeof(int16_t);
+  size_t n = q.pop(stream, len);
+  // underrun, pad with silence
+  std::fill(stream + n, stream + len, 0);
 }
 
 } // namespace sdl_internal
@@ -6,24 +6,23 @@
 #include <memory>
 #include <vector>
 
-struct SDL_AudioSpec;
+#include "audio_sink.hpp"
 
-namespace aud {
-class Generator;
-}
+struct SDL_AudioSpec;
 
 namespace sdl_internal {
 
-class Audio {
+class Audio : public aud::Sink {
 
 public:
   Audio();
   ~Audio();
 
-  void init();
+  void open(aud::SampleQueue &q, int sample_rate) override;
+  bool realtime() const override { return true; }
 
 private:
-  static void audio_callback(void *unused, uint8_t *byte_stream,
+  static void audio_callback(void *userdata, uint8_t *byte_stream,
                              int byte_stream_length);
   // must be a power of two, decrease to allow for a lower latency,
   // increase to reduce risk of underrun.
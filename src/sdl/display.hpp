@@ -1,20 +1,53 @@
 #pragma once
 
+#include "frame_pacer.hpp"
+#include "frame_queue.hpp"
+#include "video_filter.hpp"
+
 #include <SDL.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <type_traits>
 
 namespace sdl_internal {
 
-template <int W, int H, int S = 1> class Display {
+// Texture formats the display can stream into. Each packs an RGB pixel into a
+// texel the GPU can sample directly, so the driver never has to convert
+// (which for 24 bit RGB it usually does on the CPU).
+struct Argb8888 {
+  using Texel = uint32_t;
+  static constexpr uint32_t SdlFormat = SDL_PIXELFORMAT_ARGB8888;
+  static constexpr Texel pack(const std::array<uint8_t, 3> &p) {
+    return 0xFF000000u | (p[0] << 16) | (p[1] << 8) | p[2];
+  }
+};
+
+struct Rgb565 {
+  using Texel = uint16_t;
+  static constexpr uint32_t SdlFormat = SDL_PIXELFORMAT_RGB565;
+  static constexpr Texel pack(const std::array<uint8_t, 3> &p) {
+    return static_cast<Texel>(((p[0] >> 3) << 11) | ((p[1] >> 2) << 5) |
+                              (p[2] >> 3));
+  }
+};
+
+template <int W, int H, int S = 1, class Format = Argb8888> class Display {
 public:
-  Display(const std::string &name, const std::string &title) {
+  // Without vsync, presenting doesn't wait for the display, which suits
+  // adaptive sync (the display refreshes when a frame arrives).
+  Display(const std::string &name, const std::string &title,
+          bool vsync = true) {
 
     window = SDL_CreateWindow(name.c_str(), SDL_WINDOWPOS_UNDEFINED,
                               SDL_WINDOWPOS_UNDEFINED, W * S, H * S,
                               SDL_WINDOW_SHOWN);
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+    renderer =
+        SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
 
     if (window == nullptr || renderer == nullptr) {
       SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR,
@@ -36,8 +69,7 @@ public:
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
     SDL_RenderSetLogicalSize(renderer, W, H);
 
-    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24,
-                                SDL_TEXTUREACCESS_STREAMING, W, H);
+    createTexture(W, H);
   }
   ~Display() {
     SDL_DestroyRenderer(renderer);
@@ -81,16 +113,115 @@ public:
     }
   }
 
-  void update() {
-    if (shown) {
-      SDL_UpdateTexture(texture, nullptr, renderBuf.data(), W * 3);
-      SDL_RenderClear(renderer);
-      SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-      SDL_RenderPresent(renderer);
-      ++frames_;
+  using Frame = std::span<const std::array<uint8_t, 3>, W * H>;
+
+  void update(Frame frame) {
+    if (!shown) {
+      return;
+    }
+    upload(0, H, [&](uint8_t *pixels, int pitch) {
+      for (int y = 0; y < H; ++y) {
+        auto row = reinterpret_cast<Texel *>(pixels + y * pitch);
+        auto src = frame.data() + y * W;
+        for (int x = 0; x < W; ++x) {
+          row[x] = Format::pack(src[x]);
+        }
+      }
+    });
+    // no hashes to go with these rows
+    rows_valid_ = false;
+    present();
+  }
+
+  // Show the console's latest frame, through the palette or a filter. Only
+  // rows whose hashes differ from those already in the texture (and, for a
+  // filter, rows within its reach of those) are converted and uploaded, so a
+  // static screen costs nothing but the present.
+  void update(const vid::FrameQueue &frames) {
+    static_assert(W == vid::WIDTH && H == vid::HEIGHT);
+    if (!shown) {
+      return;
+    }
+    auto frame = frames.front();
+    auto rows = frames.frontRows();
+    auto phase = frames.frontPhase();
+    if (filter_ != nullptr && filter_->phaseDependent() && phase != phase_) {
+      rows_valid_ = false;
+      phase_ = phase;
+    }
+
+    int reach = filter_ != nullptr ? static_cast<int>(filter_->reach()) : 0;
+    std::array<bool, H> dirty = {};
+    bool any = false;
+    for (int y = 0; y < H; ++y) {
+      if (rows_valid_ && rows[y] == rows_[y]) {
+        continue;
+      }
+      rows_[y] = rows[y];
+      std::fill(dirty.begin() + std::max(y - reach, 0),
+                dirty.begin() + std::min(y + reach + 1, H), true);
+      any = true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+    for (int y = 0; y < H;) {
+      if (!dirty[y]) {
+        ++y;
+        continue;
+      }
+      int first = y;
+      while (y < H && dirty[y]) {
+        ++y;
+      }
+      int last = y;
+      bool done = upload(first, last, [&](uint8_t *pixels, int pitch) {
+        convert(frame, phase, first, last, pixels, pitch);
+      });
+      ok = ok && done;
+    }
+    if (any) {
+      convert_times_.add(std::chrono::steady_clock::now() - start);
     }
+    rows_valid_ = ok;
+    present();
   }
 
+  // Colors for the console's 9 bit pixels (PPU::FullPalette)
+  void setPalette(std::span<const vid::Rgb, 512> rgb) {
+    for (size_t i = 0; i < palette_.size(); ++i) {
+      palette_[i] = Format::pack(rgb[i]);
+    }
+    if constexpr (std::is_same_v<Format, Argb8888>) {
+      if (filter_ != nullptr) {
+        filter_->setPalette(palette_);
+      }
+    }
+    rows_valid_ = false;
+  }
+
+  // Convert frames through a filter (NTSC, an upscaler) rather than straight
+  // through the palette, or go back to the palette with nullptr. The filter
+  // must outlive the display.
+  void setFilter(vid::VideoFilter *filter) {
+    static_assert(std::is_same_v<Format, Argb8888>,
+                  "Video filters only produce ARGB8888");
+    filter_ = filter;
+    if (filter != nullptr) {
+      filter->setPalette(palette_);
+      createTexture(static_cast<int>(filter->width()),
+                    static_cast<int>(filter->height()));
+    } else {
+      createTexture(W, H);
+    }
+    rows_valid_ = false;
+    convert_times_ = {};
+  }
+
+  // How long each update spent converting and uploading changed rows, for
+  // judging whether a filter fits in the frame budget
+  const sys::FrameTimes &convertTimes() const { return convert_times_; }
+
   void focus() {
     if (!shown) {
       SDL_ShowWindow(window);
@@ -104,12 +235,66 @@ public:
 
   unsigned long frames() { return frames_; }
 
-  std::array<std::array<uint8_t, 3>, W *H> renderBuf = {};
-
 private:
+  using Texel = typename Format::Texel;
+
+  // The texture is W x H unless a filter enlarges it. The renderer's logical
+  // size stays W x H, so it's scaled back to the right aspect either way.
+  void createTexture(int width, int height) {
+    if (texture != nullptr) {
+      SDL_DestroyTexture(texture);
+    }
+    texture = SDL_CreateTexture(renderer, Format::SdlFormat,
+                                SDL_TEXTUREACCESS_STREAMING, width, height);
+    tex_w_ = width;
+    tex_h_ = height;
+  }
+
+  // Rows [first, last) of frame into locked texture memory
+  void convert(vid::FrameView frame, uint8_t phase, int first, int last,
+               uint8_t *pixels, int pitch) {
+    if (filter_ != nullptr) {
+      filter_->run(frame, phase, first, last,
+                   reinterpret_cast<uint32_t *>(pixels), pitch);
+      return;
+    }
+    for (int y = first; y < last; ++y) {
+      auto row = reinterpret_cast<Texel *>(pixels + (y - first) * pitch);
+      auto src = frame.data() + y * W;
+      for (int x = 0; x < W; ++x) {
+        row[x] = palette_[src[x] & 0x1FF];
+      }
+    }
+  }
+
+  // Lock the texture rows for frame rows [first, last) and have
+  // fill(pixels, pitch) convert straight into its memory, rather than handing
+  // SDL a buffer to copy (and convert) from
+  template <class F> bool upload(int first, int last, F &&fill) {
+    int scale = tex_h_ / H;
+    SDL_Rect rect = {0, first * scale, tex_w_, (last - first) * scale};
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, &rect, &pixels, &pitch) != 0) {
+      return false;
+    }
+    fill(static_cast<uint8_t *>(pixels), pitch);
+    SDL_UnlockTexture(texture);
+    return true;
+  }
+
+  void present() {
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+    SDL_RenderPresent(renderer);
+    ++frames_;
+  }
+
   SDL_Window *window;
   SDL_Renderer *renderer;
-  SDL_Texture *texture;
+  SDL_Texture *texture = nullptr;
+  int tex_w_ = W;
+  int tex_h_ = H;
   int window_id;
 
   bool mouse_focus = false;
@@ -117,5 +302,12 @@ private:
   bool shown;
   bool minimized;
   unsigned long frames_ = 0;
+  // hashes of the rows currently in the texture
+  std::array<uint64_t, H> rows_ = {};
+  bool rows_valid_ = false;
+  std::array<Texel, 512> palette_ = {};
+  vid::VideoFilter *filter_ = nullptr;
+  uint8_t phase_ = 0;
+  sys::FrameTimes convert_times_;
 };
 } // namespace sdl_internal
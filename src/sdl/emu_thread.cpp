@@ -0,0 +1,186 @@
+#include "emu_thread.hpp"
+#include "input.hpp"
+#include "system.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace sdl_internal {
+
+EmuThread::EmuThread(sys::NES &nes, aud::Sink &audio, aud::Sink *stems,
+                     MoviePlayer &movie)
+    : nes_(nes), audio_(audio), stems_(stems), movie_(movie) {}
+
+EmuThread::~EmuThread() { stop(); }
+
+void EmuThread::setLatencyProbe(sys::LatencyProbe *probe) {
+  if (thread_.joinable()) {
+    throw std::runtime_error("EmuThread already started");
+  }
+  probe_ = probe;
+  nes_.joypad_1.setProbe(probe);
+  nes_.joypad_2.setProbe(probe);
+}
+
+void EmuThread::enablePpuDebugView() {
+  if (thread_.joinable()) {
+    throw std::runtime_error("EmuThread already started");
+  }
+  if (ppu_view_ == nullptr) {
+    ppu_view_ = std::make_unique<PpuDebugView>();
+  }
+}
+
+void EmuThread::start() {
+  if (thread_.joinable()) {
+    throw std::runtime_error("EmuThread already started");
+  }
+  running_ = true;
+  thread_ = std::thread(&EmuThread::run, this);
+}
+
+void EmuThread::stop() {
+  quit_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  running_ = false;
+}
+
+void EmuThread::run() {
+  pacer_.resync();
+  while (!quit_) {
+    auto start = Clock::now();
+    bool done;
+    try {
+      done = runFrame();
+    } catch (std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      std::cerr << "Cycle: " << nes_.cycle() << std::endl;
+      std::cerr << std::hex << "PC: 0x" << +nes_.state().pc << std::dec
+                << std::endl;
+      break;
+    }
+
+    if (!done) {
+      // paused in the debugger. idle, and don't try to make up the time
+      publishPpuDebugView();
+      std::this_thread::sleep_for(pacer_.period());
+      pacer_.resync();
+      continue;
+    }
+
+    auto elapsed = Clock::now() - start;
+    ++stats_.frames;
+    stats_.total_time += elapsed;
+    stats_.max_time = std::max<std::chrono::nanoseconds>(stats_.max_time,
+                                                         elapsed);
+    if (!pacer_.wait()) {
+      ++stats_.late;
+    }
+  }
+  running_.store(false, std::memory_order_release);
+}
+
+// Run until the PPU completes a frame. Returns false if the debugger paused
+// the console first.
+bool EmuThread::runFrame() {
+  frame_cycle_ = nes_.cycle();
+  frame_time_ = Clock::now();
+  auto replay = [this](SDL_Event &e) { handleInput(e, true); };
+  movie_.generateEvents(replay);
+  pollInput(frame_cycle_);
+
+  do {
+    uint64_t cycle = nes_.cycle();
+    if (cycle >= next_poll_) {
+      pollInput(cycle);
+    }
+    if (!pending_.empty() && pending_.front().cycle <= cycle) {
+      applyInput(cycle);
+    }
+    if (movie_.nextCycle() <= cycle) {
+      movie_.generateDue(cycle, replay);
+    }
+    nes_.step();
+    if (nes_.paused()) {
+      return false;
+    }
+  } while (!nes_.render());
+
+  if (probe_ != nullptr) {
+    probe_->completed(nes_.frames().published());
+  }
+  publishPpuDebugView();
+  audio_.frame();
+  if (stems_ != nullptr) {
+    stems_->frame();
+  }
+  return true;
+}
+
+void EmuThread::pollInput(uint64_t cycle) {
+  next_poll_ = cycle + PollCycles;
+  for (auto in = input_.pop(); in; in = input_.pop()) {
+    // NOTE(oren): input from before this frame started (say, while waiting
+    // on the pacer) is due at once
+    std::chrono::duration<double> since = in->time - frame_time_;
+    auto offset =
+        static_cast<uint64_t>(std::max(since.count(), 0.0) * CyclesPerSecond);
+    pending_.push_back({*in, frame_cycle_ + offset});
+  }
+}
+
+void EmuThread::applyInput(uint64_t cycle) {
+  while (!pending_.empty() && pending_.front().cycle <= cycle) {
+    auto &p = pending_.front();
+    ++stats_.inputs;
+    stats_.input_late += cycle - p.cycle;
+    handleInput(p.in.event, p.in.focused);
+    pending_.pop_front();
+  }
+}
+
+void EmuThread::publishPpuDebugView() {
+  if (ppu_view_ == nullptr ||
+      !ppu_view_shown_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  nes_.debugger().renderPpuDbg(ppu_view_->back());
+  ppu_view_->publish();
+}
+
+// NOTE(oren): controller buttons arrive as recording events, resolved to a
+// pad on the UI thread (see ControllerInputHandler)
+void EmuThread::handleInput(SDL_Event &e, bool focused) {
+  RecordingInputHandler::HandleEvent(e, nes_, focused);
+  switch (e.type) {
+  case SDL_KEYDOWN:
+    switch (e.key.keysym.sym) {
+    case SDLK_p:
+      nes_.debugger().cyclePalete();
+      break;
+    case SDLK_r:
+      nes_.reset(true);
+      break;
+    case SDLK_1:
+    case SDLK_2:
+    case SDLK_3:
+    case SDLK_4:
+      nes_.debugger().selectNametable(e.key.keysym.sym - SDLK_1);
+      break;
+    default:
+      break;
+    }
+    // key presses also go to the pads
+    [[fallthrough]];
+  case SDL_KEYUP:
+    KeyboardInputHandler::HandleEvent(e, nes_, focused);
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace sdl_internal
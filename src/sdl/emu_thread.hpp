@@ -0,0 +1,143 @@
+#pragma once
+
+#include "audio_sink.hpp"
+#include "dbg/nes_debugger.hpp"
+#include "frame_pacer.hpp"
+#include "latency_probe.hpp"
+#include "movie_player.hpp"
+#include "util.hpp"
+
+#include <SDL.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace sys {
+class NES;
+}
+
+namespace sdl_internal {
+
+// Runs the console on its own thread, paced to the NES frame rate, so that a
+// slow present or a vsync stall on the UI thread can't hold up emulation (or,
+// through it, audio). Completed frames go out through the console's frame
+// queue.
+//
+// Once started, the console belongs to this thread. Anything else that
+// needs its state gets a copy handed over at frame boundaries: frames through
+// the console's frame queue, the PPU debug view through ppuDebugView().
+//
+// Input reaches it as forwarded SDL events, stamped with when they were
+// polled. Each frame starts
+// on its deadline, which ties the console's master clock (CPU cycles) to
+// real time, so a stamp maps to a cycle. Events are applied at the first
+// instruction on or after theirs, checking for new ones every scanline or
+// so; input that arrives while a frame is being emulated lands within it
+// rather than waiting for the next.
+class EmuThread {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // 236.25MHz / 11 / 12, ~1.79MHz
+  static constexpr double CyclesPerSecond =
+      357366.0 / 12 / sys::FramePacer::FramePeriod.count();
+
+  struct Stats {
+    uint64_t frames = 0;
+    // frames that finished after their deadline
+    uint64_t late = 0;
+    std::chrono::nanoseconds total_time{0};
+    std::chrono::nanoseconds max_time{0};
+    uint64_t inputs = 0;
+    // total cycles inputs were applied after their stamps, which happens
+    // when emulation is ahead of real time and the cycle has already passed
+    uint64_t input_late = 0;
+  };
+
+  EmuThread(sys::NES &nes, aud::Sink &audio, aud::Sink *stems,
+            MoviePlayer &movie);
+  ~EmuThread();
+
+  EmuThread(const EmuThread &) = delete;
+  EmuThread &operator=(const EmuThread &) = delete;
+
+  // Follow button presses through the console with probe. Must be set
+  // before starting.
+  void setLatencyProbe(sys::LatencyProbe *probe);
+
+  using PpuDebugView = util::TripleBuffer<sys::NESDebugger::RenderBuffer>;
+  // Render the PPU debug view at each frame boundary, and while paused, for
+  // the UI thread to pick up from ppuDebugView(). Must be enabled before
+  // starting.
+  void enablePpuDebugView();
+  // UI thread. Pause or resume rendering the debug view, say while its
+  // window is hidden.
+  void showPpuDebugView(bool show) {
+    ppu_view_shown_.store(show, std::memory_order_relaxed);
+  }
+  // Consumer side is the UI thread's. nullptr unless enabled.
+  PpuDebugView *ppuDebugView() { return ppu_view_.get(); }
+
+  void start();
+  void stop();
+  // false once stopped, or if the console threw
+  bool running() const { return running_.load(std::memory_order_acquire); }
+
+  // Called from the UI thread. Returns false if the queue is full and the
+  // event was dropped.
+  bool forward(const SDL_Event &e, bool focused) {
+    return input_.push({e, focused, Clock::now()});
+  }
+
+  // Only stable once stopped
+  const Stats &stats() const { return stats_; }
+  const sys::FrameTimes &frameTimes() const { return pacer_.times(); }
+
+private:
+  struct Input {
+    SDL_Event event;
+    bool focused;
+    Clock::time_point time;
+  };
+  struct Stamped {
+    Input in;
+    uint64_t cycle;
+  };
+
+  // CPU cycles between checks for forwarded input, about a scanline
+  static constexpr uint64_t PollCycles = 114;
+
+  void run();
+  bool runFrame();
+  // Stamp newly forwarded input
+  void pollInput(uint64_t cycle);
+  // Apply input stamped on or before cycle
+  void applyInput(uint64_t cycle);
+  void handleInput(SDL_Event &e, bool focused);
+  void publishPpuDebugView();
+
+  sys::NES &nes_;
+  aud::Sink &audio_;
+  aud::Sink *stems_;
+  MoviePlayer &movie_;
+  util::SpscQueue<Input, 256> input_;
+  std::deque<Stamped> pending_;
+  uint64_t next_poll_ = 0;
+  // the current frame's first cycle, and when it started
+  uint64_t frame_cycle_ = 0;
+  Clock::time_point frame_time_;
+  sys::FramePacer pacer_;
+  sys::LatencyProbe *probe_ = nullptr;
+  std::unique_ptr<PpuDebugView> ppu_view_;
+  std::atomic<bool> ppu_view_shown_ = true;
+  Stats stats_;
+  std::atomic<bool> quit_ = false;
+  std::atomic<bool> running_ = false;
+  std::thread thread_;
+};
+
+} // namespace sdl_internal
@@ -50,17 +50,16 @@ void ControllerInputHandler::Init() {
   assert(SDL_GameControllerEventState(SDL_ENABLE) == SDL_ENABLE);
 }
 
-void ControllerInputHandler::HandleEvent(SDL_Event &e, sys::NES &nes,
-                                         bool focused) {
+bool ControllerInputHandler::HandleEvent(SDL_Event &e, sys::NES &nes) {
   if (!Enabled) {
-    return;
+    return false;
   }
   int id = e.cdevice.which;
   switch (e.type) {
   case SDL_CONTROLLERDEVICEADDED: {
     try {
-      auto inst = std::make_unique<ControllerInputHandler>(
-          nes.getAvailablePad(), id, nes.debugger());
+      auto inst =
+          std::make_unique<ControllerInputHandler>(nes.getAvailablePad(), id);
       auto js_id = inst->js_id_;
       Instances.emplace(js_id, std::move(inst));
       std::cerr << "Controller " << +js_id << " ADDED... ("
@@ -78,15 +77,19 @@ void ControllerInputHandler::HandleEvent(SDL_Event &e, sys::NES &nes,
   } break;
   case SDL_CONTROLLERBUTTONDOWN:
   case SDL_CONTROLLERBUTTONUP: {
-    auto it = Instances.find(id);
-    if (it != Instances.end()) {
-      it->second->handleEvent(e, true);
+    auto it = Instances.find(e.cbutton.which);
+    auto btn = ToJoyPad.find(static_cast<KeyT>(e.cbutton.button));
+    if (it != Instances.end() && btn != ToJoyPad.end()) {
+      e = RecordingInputHandler::Event(it->second->joypad_.ID, btn->second,
+                                       e.cbutton.state);
+      return true;
     }
   } break;
   default:
     std::cerr << "Unhandled: " << +e.type << std::endl;
     break;
   }
+  return false;
 }
 
 const std::unordered_map<uint8_t, ctrl::Button> RecordingInputHandler::ToJoyPad{
@@ -117,10 +120,12 @@ void RecordingInputHandler::HandleEvent(SDL_Event &e, sys::NES &nes,
     return;
   }
 
-  static RecordingInputHandler instance(nes.joypad_1, nes.debugger());
+  static RecordingInputHandler pad_1(nes.joypad_1, nes.debugger());
+  static RecordingInputHandler pad_2(nes.joypad_2, nes.debugger());
 
   if (e.type == REC_EVENT) {
-    instance.handleEvent(e, true);
+    uint8_t joy_id = (e.user.code >> 16) & 0xFF;
+    (joy_id == nes.joypad_2.ID ? pad_2 : pad_1).handleEvent(e, true);
   }
 }
 
@@ -69,6 +69,11 @@ public:
 
   static void Init();
   static void HandleEvent(SDL_Event &e, sys::NES &nes, bool focused);
+  // Whether e is a fresh press (not a repeat) of a key mapped to the pad
+  static bool Presses(const SDL_Event &e) {
+    return e.type == SDL_KEYDOWN && e.key.repeat == 0 &&
+           ToJoyPad.contains(static_cast<KeyT>(e.key.keysym.sym));
+  }
   bool accept(SDL_Event &e) { return true; }
   KeyT get_key(SDL_Event &e) { return static_cast<KeyT>(e.key.keysym.sym); }
   uint8_t get_state(SDL_Event &e) { return e.key.state; }
@@ -77,10 +82,12 @@ private:
   static const KeyMap ToJoyPad;
 };
 
-class ControllerInputHandler
-    : public InputHandler<ControllerInputHandler, SDL_GameControllerButton> {
+// Game controllers live on the UI thread, which owns the SDL event loop: they
+// are opened and closed there as they come and go, and their button events
+// are resolved there to the pad they're claimed for. What reaches the
+// console is a recording event (see RecordingInputHandler) for that pad.
+class ControllerInputHandler {
   using KeyT = SDL_GameControllerButton;
-  using Parent = InputHandler<ControllerInputHandler, KeyT>;
   using KeyMap = std::unordered_map<KeyT, ctrl::Button>;
   static std::unordered_map<SDL_JoystickID,
                             std::unique_ptr<ControllerInputHandler>>
@@ -88,8 +95,7 @@ class ControllerInputHandler
   static bool Enabled;
 
 public:
-  ControllerInputHandler(ctrl::JoyPad &jp, int handle, sys::NESDebugger &dbg)
-      : Parent(jp, ToJoyPad, dbg) {
+  ControllerInputHandler(ctrl::JoyPad &jp, int handle) : joypad_(jp) {
     auto controller = SDL_GameControllerOpen(handle);
     auto joystick = SDL_GameControllerGetJoystick(controller);
     js_id_ = SDL_JoystickInstanceID(joystick);
@@ -112,12 +118,17 @@ public:
   }
 
   static void Init();
-  static void HandleEvent(SDL_Event &e, sys::NES &nes, bool focused);
-  bool accept(SDL_Event &e) { return e.cbutton.which == js_id_; }
-  KeyT get_key(SDL_Event &e) { return static_cast<KeyT>(e.cbutton.button); }
-  uint8_t get_state(SDL_Event &e) { return e.cbutton.state; }
+  // UI thread. Open or close a controller, or rewrite a button event for
+  // the emulation thread. Returns whether e should be forwarded to it.
+  static bool HandleEvent(SDL_Event &e, sys::NES &nes);
+  // Whether e is a press of a button mapped to the pad
+  static bool Presses(const SDL_Event &e) {
+    return e.type == SDL_CONTROLLERBUTTONDOWN &&
+           ToJoyPad.contains(static_cast<KeyT>(e.cbutton.button));
+  }
 
 private:
+  ctrl::JoyPad &joypad_;
   SDL_JoystickID js_id_;
   static const KeyMap ToJoyPad;
 };
@@ -136,8 +147,22 @@ public:
   ~RecordingInputHandler() = default;
 
   static void Init();
+  // Applies recording events to the pad they name
   static void HandleEvent(SDL_Event &e, sys::NES &nes, bool focused);
   static uint32_t EventType() { return REC_EVENT; }
+  // A press or release of btn on pad joy_id, encoded as
+  // NESDebugger::processInput records it
+  static SDL_Event Event(uint8_t joy_id, ctrl::Button btn, uint8_t state) {
+    return Event((static_cast<uint32_t>(joy_id) << 16) |
+                 (static_cast<uint32_t>(btn) << 8) | state);
+  }
+  static SDL_Event Event(uint32_t code) {
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = REC_EVENT;
+    e.user.code = static_cast<int32_t>(code);
+    return e;
+  }
   bool accept(SDL_Event &e) { return true; }
   KeyT get_key(SDL_Event &e) {
     return static_cast<KeyT>((e.user.code >> 8) & 0xFF);
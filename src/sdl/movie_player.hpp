@@ -4,13 +4,26 @@
 
 #include "SDL.h"
 
+#include <array>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <limits>
 
 namespace sdl_internal {
 
+// Plays back controller recordings (--record).
+//
+// Recordings start with Magic, then hold the CPU cycle and the event (see
+// NESDebugger::processInput) for each press and release, so playback lands
+// every one on exactly the cycle it was recorded on. Older recordings have
+// no header and mark frame boundaries instead, with each frame's events
+// applied as it starts.
 class MoviePlayer {
 public:
   static constexpr uint32_t END_FRAME = 0xFFFFFFFF;
+  static constexpr auto Magic = sys::NESDebugger::MovieMagic;
+  static constexpr uint64_t Never = std::numeric_limits<uint64_t>::max();
 
   MoviePlayer(const std::string &fname) {
     if (!fname.empty()) {
@@ -21,34 +34,64 @@ public:
       }
       std::cerr << std::endl;
     }
-    // TODO(oren): add a header of some kind to validate movie-ness of the
-    // specified file
+    if (m_stream_) {
+      std::array<char, Magic.size()> magic = {};
+      m_stream_.read(magic.data(), magic.size());
+      timed_ = m_stream_ && magic == Magic;
+      if (timed_) {
+        readTimed();
+      } else {
+        m_stream_.clear();
+        m_stream_.seekg(0);
+      }
+    }
   }
 
-  void generateEvents() {
-    if (!m_stream_ || m_stream_.eof()) {
+  // Whether events carry cycle stamps (as opposed to frame boundaries)
+  bool timed() const { return timed_; }
+  // Cycle the next timed event is due on
+  uint64_t nextCycle() const { return next_cycle_; }
+
+  // Deliver recorded input due by cycle to handle(SDL_Event &). Only for
+  // timed recordings.
+  template <class F> void generateDue(uint64_t cycle, F &&handle) {
+    while (next_cycle_ <= cycle) {
+      auto e = RecordingInputHandler::Event(next_code_);
+      handle(e);
+      readTimed();
+    }
+  }
+
+  // Deliver the next frame's worth of recorded input to handle(SDL_Event &).
+  // Only for untimed recordings.
+  template <class F> void generateEvents(F &&handle) {
+    if (timed_ || !m_stream_ || m_stream_.eof()) {
       return;
     }
     uint32_t next = 0;
     m_stream_.read(reinterpret_cast<char *>(&next), sizeof(next));
 
     while (!m_stream_.eof() && next != END_FRAME) {
-      SDL_Event event;
-      SDL_zero(event);
-      event.type = sdl_internal::RecordingInputHandler::EventType();
-      event.user.code = next;
-      auto res = SDL_PushEvent(&event) == 1;
-      assert(res != 0);
-      if (res == 1) {
-        m_stream_.read(reinterpret_cast<char *>(&next), sizeof(next));
-      } else {
-        std::cerr << "MoviePlayer ERROR: " << SDL_GetError() << std::endl;
-      }
+      auto e = RecordingInputHandler::Event(next);
+      handle(e);
+      m_stream_.read(reinterpret_cast<char *>(&next), sizeof(next));
     }
   }
 
 private:
+  void readTimed() {
+    uint64_t cycle = 0;
+    uint32_t code = 0;
+    m_stream_.read(reinterpret_cast<char *>(&cycle), sizeof(cycle));
+    m_stream_.read(reinterpret_cast<char *>(&code), sizeof(code));
+    next_cycle_ = m_stream_ ? cycle : Never;
+    next_code_ = code;
+  }
+
   std::ifstream m_stream_;
+  bool timed_ = false;
+  uint64_t next_cycle_ = Never;
+  uint32_t next_code_ = 0;
 };
 
 } // namespace sdl_internal
@@ -15,11 +15,13 @@ NES::NES(std::string_view const &romfile, bool debug, bool quiet)
     : debug_(debug), cartridge_(romfile),
       mapper_(MapperFactory(*this, cartridge_, ppu_registers_, apu_registers_,
                             ppu_oam_, joypad_1)),
-      ppu_(*mapper_, ppu_registers_, ppu_oam_), apu_(*mapper_, apu_registers_),
-      cpu_(*mapper_, false), debugger_(*this) {
+      ppu_(*mapper_, ppu_registers_, ppu_oam_, frames_),
+      apu_(*mapper_, apu_registers_), cpu_(*mapper_, false), debugger_(*this) {
   cpu_.registerTickHandler(std::bind(&NES::ppuTick, this));
   cpu_.registerTickHandler(std::bind(&NES::mapperTick, this));
   cpu_.registerTickHandler(std::bind(&NES::apuTick, this));
+  cpu_.registerTickHandler(std::bind(&NES::dmaTick, this));
+  mapper_->setApuAccessHandler(std::bind(&NES::apuAccess, this));
   reset();
   if (!quiet) {
     std::cerr << cartridge_ << std::endl;
@@ -27,27 +29,88 @@ NES::NES(std::string_view const &romfile, bool debug, bool quiet)
 }
 
 void NES::step() {
-  if (!debug_) {
-    cpu_.step();
-  } else if (!debugger_.paused()) {
+  if (paused()) {
+    // breakpoints are mostly edited while stopped, so the list shows them
+    debugger_.applyEdits();
+    return;
+  } else if (debug_ && debugger_.hooked()) {
     cpu_.debugStep(debugger_);
+  } else {
+    cpu_.step();
   }
 }
 
-bool NES::render(RenderBuffer &renderBuf) {
+void NES::syncApu() {
+  auto &dma = mapper_->dma();
+  auto cycle = mapper_->cycle() - apu_lag_;
+  while (apu_lag_ > 0) {
+    auto n = apu_.run(apu_lag_);
+    apu_lag_ -= n;
+    cycle += n;
+    if (apu_.stallCpu()) {
+      dma.dmc(cycle);
+    }
+  }
+  scheduleApu();
+}
 
-  // NOTE(oren): isFrameReady clears the frame ready flag regardless of status,
-  // so effectively for each completed frame only one invocation will return
-  // true until the next frame is completed.
-  if (ppu_registers_.isFrameReady()) {
-    std::copy(ppu_.frameBuffer().begin(), ppu_.frameBuffer().end(),
-              renderBuf.begin());
-    ppu_.clearFrame();
-    debugger_.nextFrame();
-    return true;
+void NES::scheduleApu() {
+  apu_irq_ = apu_.pendingIrq();
+  if (apu_eager_ > 0) {
+    --apu_eager_;
+    apu_budget_ = 1;
   } else {
+    apu_budget_ = apu_.deferrableSteps();
+  }
+}
+
+void NES::apuAccess() {
+  syncApu();
+  // NOTE(oren): register writes take effect over the next few APU steps (a
+  // $4017 reset lands up to 3 cycles later), and predictions made before then
+  // would be stale. Stay in lockstep until things settle.
+  apu_eager_ = 4;
+  apu_budget_ = 1;
+}
+
+// NOTE(oren): the CPU is halted for the duration of a DMA, so nothing can
+// observe the bus in the meantime. The PPU still runs a cycle at a time so
+// the NMI edge detector, which keeps going while the CPU is halted, sees a
+// vblank that starts partway through. The APU does too, since a DMC fetch
+// partway through extends the halt. The mapper takes the whole stretch at
+// once.
+bool NES::dmaTick() {
+  auto &dma = mapper_->dma();
+  auto n = dma.take();
+  if (n == 0) {
     return false;
   }
+
+  syncApu();
+  for (; n > 0; n = dma.take()) {
+    auto base = mapper_->cycle();
+    for (uint16_t i = 0; i < n; ++i) {
+      ppuTick();
+      apu_.step();
+      if (apu_.stallCpu()) {
+        dma.dmc(base + i);
+      }
+      dma.clock();
+    }
+    mapper_->tick(n);
+    dma_cycles_ += n;
+  }
+  scheduleApu();
+  return false;
+}
+
+bool NES::render() {
+
+  // NOTE(oren): isFrameReady clears the frame ready flag regardless of status,
+  // so effectively for each completed frame only one invocation will return
+  // true until the next frame is completed. The PPU has already published the
+  // frame by then.
+  return ppu_registers_.isFrameReady();
 }
 
 } // namespace sys
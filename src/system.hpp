@@ -1,6 +1,7 @@
 #pragma once
 
 #include "apu.hpp"
+#include "audio_sink.hpp"
 #include "cartridge.hpp"
 #include "cpu.hpp"
 #include "dbg/nes_debugger.hpp"
@@ -12,20 +13,27 @@
 namespace sys {
 
 class NES {
-  using RenderBuffer =
-      std::array<std::array<uint8_t, 3>, vid::WIDTH * vid::HEIGHT>;
-
 public:
   NES(std::string_view const &romfile, bool debug = false, bool quiet = false);
   ~NES() = default;
   void step();
-  bool render(RenderBuffer &renderBuf);
+  // Whether a frame has completed since the last call. If so, it's been
+  // published to frames().
+  bool render();
+  // Completed frames. The console is the producer; whoever presents or
+  // records them is the (single) consumer.
+  vid::FrameQueue &frames() { return frames_; }
   void reset(bool force = false) {
     cpu_.reset(force);
+    apuAccess();
     apu_.reset(force);
   };
   void reset(uint16_t addr) { cpu_.reset(static_cast<uint16_t>(addr)); }
   cpu::CpuState const &state() { return cpu_.state(); }
+  // CPU cycles including those spent halted for DMA, which state().cycle
+  // doesn't count. Anything keyed to elapsed time should use this.
+  uint64_t cycle() { return cpu_.state().cycle + dma_cycles_; }
+  uint64_t dmaCycles() const { return dma_cycles_; }
   uint16_t currScanline() { return ppu_.currScanline(); }
   uint16_t currPpuCycle() { return ppu_.currCycle(); }
 
@@ -33,6 +41,20 @@ public:
 
   NESDebugger &debugger() { return debugger_; }
   mapper::NESMapper &mapper() { return *mapper_; }
+  aud::SampleQueue &audio() { return apu_.output(); }
+  // Route audio output to sink. A sink that doesn't drain in real time gets
+  // fixed-rate, reproducible samples.
+  void setAudioSink(aud::Sink &sink) {
+    sink.open(apu_.output(), aud::SampleRate);
+    apu_.setRateControl(sink.realtime());
+  }
+  // Route per-channel stems (5 interleaved channels) to sink
+  void setStemSink(aud::Sink &sink) {
+    apu_.enableStems(true);
+    sink.open(*apu_.stems(), aud::SampleRate);
+  }
+  void setAudioLatency(double ms) { apu_.setLatency(ms); }
+  double audioLatency() const { return apu_.latency(); }
 
   bool paused() const { return debug_ && debugger_.paused(); }
 
@@ -61,7 +83,7 @@ public:
 
 private:
   bool ppuTick() {
-    ppu_.step(1 + ppu_registers_.oamCycles(), cpu_.nmiPin());
+    ppu_.step(1, cpu_.nmiPin());
     // CPU should poll the nmi line at the beginning of the second "half" of the
     // cycle. we can't subdivide a cpu clock any further, so we'll poll after
     // the first PPU cycle clocked by each CPU tick.
@@ -74,28 +96,40 @@ private:
     mapper_->tick(1);
     return mapper_->pendingIrq();
   }
+  // The APU runs lazily. Ticks only accumulate until the APU reaches a point
+  // the CPU could observe (an IRQ, a DMC fetch, a finished block of audio) or
+  // the CPU touches its registers, then it catches up in one go.
   bool apuTick() {
-    apu_.step();
-    if (apu_.stallCpu()) {
-      // TODO(oren): determine stall length cleverly
-      cpu_.stall(4);
-      // for (int i = 0; i < 4; ++i) {
-      //   apu_.step(cpu_.irqPin());
-      // }
+    if (++apu_lag_ >= apu_budget_) {
+      syncApu();
     }
-    return apu_.pendingIrq();
+    return apu_irq_;
   }
+  void syncApu();
+  void scheduleApu();
+  void apuAccess();
+  bool dmaTick();
 
   cart::Cartridge cartridge_;
   vid::Registers ppu_registers_;
   aud::Registers apu_registers_;
   std::array<uint8_t, 256> ppu_oam_ = {};
   std::unique_ptr<mapper::NESMapper> mapper_;
+  vid::FrameQueue frames_;
   vid::PPU ppu_;
   aud::APU apu_;
   cpu::M6502 cpu_;
   NESDebugger debugger_;
 
+  // CPU ticks the APU is behind by, and how far behind it may fall
+  uint32_t apu_lag_ = 0;
+  uint32_t apu_budget_ = 1;
+  // ticks left to run in lockstep after a register access
+  uint32_t apu_eager_ = 0;
+  bool apu_irq_ = false;
+  // halted cycles clocked through by dmaTick
+  uint64_t dma_cycles_ = 0;
+
   friend class NESDebugger;
 };
 } // namespace sys
@@ -0,0 +1,323 @@
+#include "upscaler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace vid {
+
+namespace {
+
+// The Scale rules are written once against Vec, a run of Dots pixels with
+// comparisons yielding all-ones or all-zeros masks per pixel
+#if defined(__SSE2__)
+using Vec = __m128i;
+constexpr size_t Dots = 8;
+Vec load(const Pixel *p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+void store(Pixel *p, Vec v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+}
+Vec eq(Vec a, Vec b) { return _mm_cmpeq_epi16(a, b); }
+Vec ne(Vec a, Vec b) { return _mm_xor_si128(eq(a, b), _mm_set1_epi16(-1)); }
+Vec both(Vec a, Vec b) { return _mm_and_si128(a, b); }
+Vec either(Vec a, Vec b) { return _mm_or_si128(a, b); }
+Vec pick(Vec mask, Vec a, Vec b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#else
+using Vec = Pixel;
+constexpr size_t Dots = 1;
+Vec load(const Pixel *p) { return *p; }
+void store(Pixel *p, Vec v) { *p = v; }
+Vec eq(Vec a, Vec b) { return a == b ? 0xFFFF : 0; }
+Vec ne(Vec a, Vec b) { return a != b ? 0xFFFF : 0; }
+Vec both(Vec a, Vec b) { return a & b; }
+Vec either(Vec a, Vec b) { return a | b; }
+Vec pick(Vec mask, Vec a, Vec b) { return (mask & a) | (~mask & b); }
+#endif
+
+uint32_t *nextRow(uint32_t *row, size_t pitch) {
+  return reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(row) +
+                                      pitch);
+}
+
+// d + (s - d) * w / 256, per channel
+uint32_t blend(uint32_t d, uint32_t s, int w) {
+  uint32_t out = 0xFF000000u;
+  for (int shift = 0; shift < 24; shift += 8) {
+    int a = (d >> shift) & 0xFF;
+    int b = (s >> shift) & 0xFF;
+    out |= static_cast<uint32_t>(a + (((b - a) * w) >> 8)) << shift;
+  }
+  return out;
+}
+
+// 2xBR's taps, named as in the reference implementation: the 3x3 window
+// A-I around E, plus F4, I4 to the right and H5, I5 below
+enum Tap { E, B, C, D, F, G, H, I, F4, H5, I4, I5, Taps };
+struct Offset {
+  int x, y;
+};
+constexpr std::array<Offset, Taps> Window = {{
+    {0, 0},
+    {0, -1},
+    {1, -1},
+    {-1, 0},
+    {1, 0},
+    {-1, 1},
+    {0, 1},
+    {1, 1},
+    {2, 0},
+    {0, 2},
+    {2, 1},
+    {1, 2},
+}};
+
+// The rules are written for the bottom right corner. Turning the window a
+// quarter at a time covers the other three.
+struct Rotation {
+  // pixel offsets of each tap in padded rows of the given stride
+  std::array<int, Taps> taps;
+  // output dots (0-3, across then down) at the corner (n3) and either side
+  // of it along the bottom (n2) and right (n1) edges
+  int n1, n2, n3;
+};
+
+constexpr Offset rotate(Offset o, int quarters) {
+  for (int i = 0; i < quarters; ++i) {
+    o = {o.y, -o.x};
+  }
+  return o;
+}
+
+constexpr int quadrant(Offset o) { return (o.y > 0) * 2 + (o.x > 0); }
+
+template <int Stride> constexpr std::array<Rotation, 4> rotations() {
+  std::array<Rotation, 4> rots = {};
+  for (int r = 0; r < 4; ++r) {
+    for (int t = 0; t < Taps; ++t) {
+      auto o = rotate(Window[t], r);
+      rots[r].taps[t] = o.y * Stride + o.x;
+    }
+    rots[r].n1 = quadrant(rotate({1, -1}, r));
+    rots[r].n2 = quadrant(rotate({-1, 1}, r));
+    rots[r].n3 = quadrant(rotate({1, 1}, r));
+  }
+  return rots;
+}
+} // namespace
+
+Upscaler::Upscaler(Kind kind, size_t threads)
+    : kind_(kind), scale_(kind == Kind::Scale3x ? 3 : 2), pool_(threads) {
+  for (Pixel p = 0; p < canon_.size(); ++p) {
+    canon_[p] = p;
+  }
+}
+
+Upscaler::Kind Upscaler::parse(const std::string &name) {
+  if (name == "scale2x") {
+    return Kind::Scale2x;
+  } else if (name == "scale3x") {
+    return Kind::Scale3x;
+  } else if (name == "xbr2x") {
+    return Kind::Xbr2x;
+  }
+  throw std::invalid_argument("Unknown upscaler '" + name +
+                              "', expected scale2x, scale3x or xbr2x");
+}
+
+const char *Upscaler::name() const {
+  switch (kind_) {
+  case Kind::Scale2x:
+    return "scale2x";
+  case Kind::Scale3x:
+    return "scale3x";
+  case Kind::Xbr2x:
+    return "xbr2x";
+  }
+  return "";
+}
+
+void Upscaler::setPalette(std::span<const uint32_t, 512> argb) {
+  std::copy(argb.begin(), argb.end(), argb_.begin());
+  for (Pixel p = 0; p < argb_.size(); ++p) {
+    canon_[p] = static_cast<Pixel>(
+        std::find(argb_.begin(), argb_.end(), argb_[p]) - argb_.begin());
+    int r = (argb_[p] >> 16) & 0xFF;
+    int g = (argb_[p] >> 8) & 0xFF;
+    int b = argb_[p] & 0xFF;
+    yuv_[p] = {(299 * r + 587 * g + 114 * b) / 1000,
+               (-169 * r - 331 * g + 500 * b) / 1000,
+               (500 * r - 419 * g - 81 * b) / 1000};
+  }
+}
+
+void Upscaler::run(FrameView frame, uint8_t, size_t first, size_t last,
+                   uint32_t *out, size_t pitch) {
+  const int reach = static_cast<int>(this->reach());
+  size_t bands = (last - first + Band - 1) / Band;
+  pool_.run(bands, [&](size_t band) {
+    size_t begin = first + band * Band;
+    size_t end = std::min(begin + Band, last);
+
+    // This band's rows and those within reach, canonicalized, with the edge
+    // dots repeated so the rules never need bounds checks. Rows past the
+    // top and bottom repeat the edge rows likewise.
+    std::array<PaddedRow, Band + 4> rows;
+    for (int i = 0; i < static_cast<int>(end - begin) + 2 * reach; ++i) {
+      int y = std::clamp(static_cast<int>(begin) - reach + i, 0,
+                         static_cast<int>(HEIGHT) - 1);
+      const Pixel *src = frame.data() + y * WIDTH;
+      auto &row = rows[i];
+      for (size_t x = 0; x < WIDTH; ++x) {
+        row[Pad + x] = canon_[src[x] & 0x1FF];
+      }
+      std::fill(row.begin(), row.begin() + Pad, row[Pad]);
+      std::fill(row.begin() + Pad + WIDTH, row.end(), row[Pad + WIDTH - 1]);
+    }
+
+    for (size_t y = begin; y < end; ++y) {
+      const PaddedRow *window = rows.data() + (y - begin);
+      auto dst = reinterpret_cast<uint32_t *>(
+          reinterpret_cast<uint8_t *>(out) + (y - first) * scale_ * pitch);
+      switch (kind_) {
+      case Kind::Scale2x:
+        scale2xRow(window, dst, pitch);
+        break;
+      case Kind::Scale3x:
+        scale3xRow(window, dst, pitch);
+        break;
+      case Kind::Xbr2x:
+        xbr2xRow(window, dst, pitch);
+        break;
+      }
+    }
+  });
+}
+
+void Upscaler::scale2xRow(const PaddedRow *rows, uint32_t *out,
+                          size_t pitch) const {
+  uint32_t *lines[2] = {out, nextRow(out, pitch)};
+  for (size_t x = 0; x < WIDTH; x += Dots) {
+    const Pixel *e = rows[1].data() + Pad + x;
+    Vec b = load(e - Stride), d = load(e - 1), c = load(e);
+    Vec f = load(e + 1), h = load(e + Stride);
+    // only where E isn't in the middle of a line or a solid area
+    Vec edge = both(ne(b, h), ne(d, f));
+
+    std::array<std::array<Pixel, Dots>, 4> q;
+    store(q[0].data(), pick(both(edge, eq(d, b)), d, c));
+    store(q[1].data(), pick(both(edge, eq(b, f)), f, c));
+    store(q[2].data(), pick(both(edge, eq(d, h)), d, c));
+    store(q[3].data(), pick(both(edge, eq(h, f)), f, c));
+    for (size_t i = 0; i < Dots; ++i) {
+      size_t o = 2 * (x + i);
+      lines[0][o] = argb_[q[0][i]];
+      lines[0][o + 1] = argb_[q[1][i]];
+      lines[1][o] = argb_[q[2][i]];
+      lines[1][o + 1] = argb_[q[3][i]];
+    }
+  }
+}
+
+void Upscaler::scale3xRow(const PaddedRow *rows, uint32_t *out,
+                          size_t pitch) const {
+  uint32_t *lines[3] = {out, nextRow(out, pitch),
+                        nextRow(nextRow(out, pitch), pitch)};
+  for (size_t x = 0; x < WIDTH; x += Dots) {
+    const Pixel *e = rows[1].data() + Pad + x;
+    Vec a = load(e - Stride - 1), b = load(e - Stride);
+    Vec c = load(e - Stride + 1), d = load(e - 1), m = load(e);
+    Vec f = load(e + 1), g = load(e + Stride - 1), h = load(e + Stride);
+    Vec i = load(e + Stride + 1);
+    Vec edge = both(ne(b, h), ne(d, f));
+    Vec db = both(edge, eq(d, b));
+    Vec bf = both(edge, eq(b, f));
+    Vec dh = both(edge, eq(d, h));
+    Vec hf = both(edge, eq(h, f));
+
+    std::array<std::array<Pixel, Dots>, 9> q;
+    store(q[0].data(), pick(db, d, m));
+    store(q[1].data(),
+          pick(either(both(db, ne(m, c)), both(bf, ne(m, a))), b, m));
+    store(q[2].data(), pick(bf, f, m));
+    store(q[3].data(),
+          pick(either(both(db, ne(m, g)), both(dh, ne(m, a))), d, m));
+    store(q[4].data(), m);
+    store(q[5].data(),
+          pick(either(both(bf, ne(m, i)), both(hf, ne(m, c))), f, m));
+    store(q[6].data(), pick(dh, d, m));
+    store(q[7].data(),
+          pick(either(both(dh, ne(m, i)), both(hf, ne(m, g))), h, m));
+    store(q[8].data(), pick(hf, f, m));
+    for (size_t k = 0; k < Dots; ++k) {
+      size_t o = 3 * (x + k);
+      for (int j = 0; j < 9; ++j) {
+        lines[j / 3][o + j % 3] = argb_[q[j][k]];
+      }
+    }
+  }
+}
+
+void Upscaler::xbr2xRow(const PaddedRow *rows, uint32_t *out,
+                        size_t pitch) const {
+  static constexpr auto Rotations = rotations<Stride>();
+  uint32_t *lines[2] = {out, nextRow(out, pitch)};
+  for (size_t x = 0; x < WIDTH; ++x) {
+    const Pixel *e = rows[2].data() + Pad + x;
+    uint32_t center = argb_[*e];
+    std::array<uint32_t, 4> q = {center, center, center, center};
+
+    for (auto &rot : Rotations) {
+      auto at = [&](Tap t) { return e[rot.taps[t]]; };
+      Pixel pe = *e, pb = at(B), pc = at(C), pd = at(D), pf = at(F);
+      Pixel pg = at(G), ph = at(H), pi = at(I);
+      if (pe == ph || pe == pf) {
+        continue;
+      }
+      // how strongly the pixels run along the edge through H and F versus
+      // across it, through E and I
+      int along = distance(pe, pc) + distance(pe, pg) +
+                  distance(pi, at(H5)) + distance(pi, at(F4)) +
+                  4 * distance(ph, pf);
+      int across = distance(ph, pd) + distance(ph, at(I5)) +
+                   distance(pf, at(I4)) + distance(pf, pb) +
+                   4 * distance(pe, pi);
+      if (along >= across) {
+        continue;
+      }
+
+      uint32_t px = argb_[distance(pe, pf) <= distance(pe, ph) ? pf : ph];
+      // shallow and steep edges reach into the neighboring dots
+      int ke = distance(pf, pg);
+      int ki = distance(ph, pc);
+      bool shallow = 2 * ke <= ki && pe != pg && pd != pg;
+      bool steep = ke >= 2 * ki && pe != pc && pb != pc;
+      if (shallow && steep) {
+        q[rot.n3] = blend(q[rot.n3], px, 224);
+        q[rot.n2] = blend(q[rot.n2], px, 64);
+        q[rot.n1] = q[rot.n2];
+      } else if (shallow) {
+        q[rot.n3] = blend(q[rot.n3], px, 192);
+        q[rot.n2] = blend(q[rot.n2], px, 64);
+      } else if (steep) {
+        q[rot.n3] = blend(q[rot.n3], px, 192);
+        q[rot.n1] = blend(q[rot.n1], px, 64);
+      } else {
+        q[rot.n3] = blend(q[rot.n3], px, 128);
+      }
+    }
+
+    lines[0][2 * x] = q[0];
+    lines[0][2 * x + 1] = q[1];
+    lines[1][2 * x] = q[2];
+    lines[1][2 * x + 1] = q[3];
+  }
+}
+
+} // namespace vid
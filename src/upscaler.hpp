@@ -0,0 +1,74 @@
+#pragma once
+
+#include "frame_queue.hpp"
+#include "video_filter.hpp"
+#include "worker_pool.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string>
+
+namespace vid {
+
+// Pixel art upscalers, which enlarge the picture by guessing at the edges
+// the artist meant rather than repeating dots.
+//
+// Scale2x and Scale3x (AdvanceMAME) pick each output dot from the input dot
+// or one of its neighbors by comparing pixel values, so they work on the raw
+// 9 bit pixels, 8 at a time. 2xBR (Hyllian's xBR, level 2) weighs color
+// distances over a 5x5 window to find the dominant edge direction and blends
+// along it, so it works in RGB and runs a dot at a time.
+class Upscaler : public VideoFilter {
+public:
+  enum class Kind { Scale2x, Scale3x, Xbr2x };
+
+  // Rows are split across the given number of worker threads plus the
+  // calling thread.
+  explicit Upscaler(Kind kind, size_t threads = 2);
+
+  // "scale2x", "scale3x" or "xbr2x"
+  static Kind parse(const std::string &name);
+
+  const char *name() const override;
+  size_t scaleX() const override { return scale_; }
+  size_t scaleY() const override { return scale_; }
+  size_t reach() const override { return kind_ == Kind::Xbr2x ? 2 : 1; }
+  void setPalette(std::span<const uint32_t, 512> argb) override;
+
+  void run(FrameView frame, uint8_t phase, size_t first, size_t last,
+           uint32_t *out, size_t pitch) override;
+
+private:
+  // rows per job handed to the pool
+  static constexpr size_t Band = 16;
+  // edge dots repeated either side of a padded row
+  static constexpr size_t Pad = 8;
+  using PaddedRow = std::array<Pixel, WIDTH + 2 * Pad>;
+  static constexpr int Stride = WIDTH + 2 * Pad;
+
+  void scale2xRow(const PaddedRow *rows, uint32_t *out, size_t pitch) const;
+  void scale3xRow(const PaddedRow *rows, uint32_t *out, size_t pitch) const;
+  void xbr2xRow(const PaddedRow *rows, uint32_t *out, size_t pitch) const;
+
+  // xBR's color distance, weighted towards luma
+  int distance(Pixel a, Pixel b) const {
+    auto &p = yuv_[a];
+    auto &q = yuv_[b];
+    return 48 * std::abs(p[0] - q[0]) + 7 * std::abs(p[1] - q[1]) +
+           6 * std::abs(p[2] - q[2]);
+  }
+
+  Kind kind_;
+  size_t scale_;
+  std::array<uint32_t, 512> argb_ = {};
+  // the lowest pixel value with the same color as each (black comes in
+  // several), so the filters compare colors rather than values
+  std::array<Pixel, 512> canon_ = {};
+  std::array<std::array<int, 3>, 512> yuv_ = {};
+  util::WorkerPool pool_;
+};
+
+} // namespace vid
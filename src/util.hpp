@@ -1,10 +1,12 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <ostream>
 
 namespace util {
@@ -19,47 +21,17 @@ static constexpr uint8_t BIT7 = 0b10000000;
 
 void reverseByte(uint8_t &b);
 
+// Fixed-capacity ring buffer. Slots are stored inline, so inserting never
+// touches the heap.
 template <typename T, size_t Cap,
-          typename StoreT = std::array<std::unique_ptr<T>, Cap>>
+          typename StoreT = std::array<std::optional<T>, Cap>>
 class RingBuf {
 public:
   RingBuf(){};
   ~RingBuf() = default;
-  RingBuf(const RingBuf &other) {
-    for (int i = 0; i < Cap; ++i) {
-      auto &oit = other.store_[i];
-      if (oit != nullptr) {
-        store_[i] = std::make_unique<T>(oit);
-      } else {
-        store_[i] = nullptr;
-      }
-    }
-    tail_ = other.tail_;
-    head_ = other.head_;
-    size_ = other.size_;
-  }
-
-  RingBuf &operator=(const RingBuf &other) {
-    if (this == &other) {
-      return *this;
-    }
-
-    for (int i = 0; i < Cap; ++i) {
-      auto &oit = other.store_[i];
-      if (oit != nullptr) {
-        store_[i] = std::make_unique<T>(oit);
-      } else {
-        store_[i] = nullptr;
-      }
-    }
-    tail_ = other.tail_;
-    head_ = other.head_;
-    size_ = other.size_;
-    return *this;
-  }
 
   void insert(const T &item) {
-    store_[tail_] = std::make_unique<T>(item);
+    store_[tail_].emplace(item);
     ++tail_;
     if (tail_ == Cap) {
       tail_ = 0;
@@ -95,7 +67,7 @@ public:
     auto idx = rb.head_;
     int rel_i = 0;
     os << "Size: " << +rb.size_ << std::endl;
-    while ((idx != rb.tail_ || rel_i == 0) && rb.store_[idx] != nullptr) {
+    while ((idx != rb.tail_ || rel_i == 0) && rb.store_[idx].has_value()) {
       os << "[" << +rel_i << "] " << idx << ": " << *rb.store_[idx] << "\n";
       ++idx;
       if (idx == Cap) {
@@ -113,4 +85,85 @@ private:
   size_t size_ = 0;
 };
 
+// Fixed-capacity wait-free single-producer/single-consumer queue, for handing
+// small items from one thread to another. Neither side ever blocks; a push to
+// a full queue just fails.
+template <typename T, size_t Cap> class SpscQueue {
+  static_assert(Cap > 0 && (Cap & (Cap - 1)) == 0,
+                "SpscQueue capacity must be a power of 2");
+
+public:
+  // Producer side
+  bool push(const T &item) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Cap) {
+      return false;
+    }
+    store_[head & (Cap - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  std::optional<T> pop() {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+    T item = store_[tail & (Cap - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return item;
+  }
+
+  // Items queued. Exact on either side's thread as far as its own operations
+  // go; the other side may move it at any time.
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::array<T, Cap> store_ = {};
+  // indices increase monotonically and are masked on access
+  alignas(64) std::atomic<size_t> head_ = 0;
+  alignas(64) std::atomic<size_t> tail_ = 0;
+};
+
+// Hands the latest of a stream of values from one thread to another, triple
+// buffered the same way as vid::FrameQueue. The producer fills back() and
+// publishes it, the consumer acquires it as front(), and a third slot sits
+// between them, so handing over is an exchange of indices and neither side
+// waits on the other. A value the consumer never got to is overwritten.
+template <typename T> class TripleBuffer {
+public:
+  // Producer side
+  T &back() { return bufs_[back_]; }
+  void publish() {
+    auto prev = ready_.exchange(back_ | Fresh, std::memory_order_acq_rel);
+    back_ = prev & IndexMask;
+  }
+
+  // Consumer side. Move the latest value to the front, if there's one we
+  // haven't seen. Returns whether the front changed.
+  bool acquire() {
+    if ((ready_.load(std::memory_order_relaxed) & Fresh) == 0) {
+      return false;
+    }
+    auto prev = ready_.exchange(front_, std::memory_order_acq_rel);
+    front_ = prev & IndexMask;
+    return true;
+  }
+  // Consumer side. Valid until the next acquire().
+  const T &front() const { return bufs_[front_]; }
+
+private:
+  static constexpr uint8_t IndexMask = 0b011;
+  static constexpr uint8_t Fresh = 0b100;
+
+  std::array<T, 3> bufs_ = {};
+  uint8_t back_ = 0;
+  std::atomic<uint8_t> ready_ = 1;
+  uint8_t front_ = 2;
+};
+
 } // namespace util
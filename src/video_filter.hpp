@@ -0,0 +1,39 @@
+#pragma once
+
+#include "frame_queue.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace vid {
+
+// A stage between the frame queue and the display's texture, turning the
+// console's raw pixels into ARGB8888 at some multiple of its resolution.
+class VideoFilter {
+public:
+  virtual ~VideoFilter() = default;
+
+  virtual const char *name() const = 0;
+  // output dots per input dot, across and down
+  virtual size_t scaleX() const = 0;
+  virtual size_t scaleY() const = 0;
+  size_t width() const { return WIDTH * scaleX(); }
+  size_t height() const { return HEIGHT * scaleY(); }
+
+  // Input rows either side of a row that its output depends on. When a row
+  // changes, this many rows around it have to be filtered again too.
+  virtual size_t reach() const { return 0; }
+  // Whether the output depends on the frame's subcarrier phase
+  virtual bool phaseDependent() const { return false; }
+  // ARGB8888 colors for the 512 pixel values, for filters that work in RGB
+  virtual void setPalette(std::span<const uint32_t, 512> argb) {}
+
+  // Filter input rows [first, last) of frame. Output row first * scaleY()
+  // starts at out, and each following row pitch bytes after the last. phase
+  // is the frame's starting subcarrier phase (FrameQueue::frontPhase).
+  virtual void run(FrameView frame, uint8_t phase, size_t first, size_t last,
+                   uint32_t *out, size_t pitch) = 0;
+};
+
+} // namespace vid
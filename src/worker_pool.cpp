@@ -0,0 +1,71 @@
+#include "worker_pool.hpp"
+
+namespace util {
+
+WorkerPool::WorkerPool(size_t threads) {
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(&WorkerPool::work, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard lock(mtx_);
+    quit_ = true;
+  }
+  start_.notify_all();
+  for (auto &w : workers_) {
+    w.join();
+  }
+}
+
+void WorkerPool::run(size_t jobs, const std::function<void(size_t)> &fn) {
+  if (workers_.empty()) {
+    for (size_t i = 0; i < jobs; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard lock(mtx_);
+    fn_ = &fn;
+    jobs_ = jobs;
+    next_ = 0;
+    busy_ = workers_.size();
+    ++batch_;
+  }
+  start_.notify_all();
+  drain();
+
+  std::unique_lock lock(mtx_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  fn_ = nullptr;
+}
+
+void WorkerPool::work() {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mtx_);
+      start_.wait(lock, [&] { return quit_ || batch_ != seen; });
+      if (quit_) {
+        return;
+      }
+      seen = batch_;
+    }
+    drain();
+    std::lock_guard lock(mtx_);
+    if (--busy_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void WorkerPool::drain() {
+  for (auto i = next_++; i < jobs_; i = next_++) {
+    (*fn_)(i);
+  }
+}
+
+} // namespace util
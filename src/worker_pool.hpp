@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+// A handful of threads to split a job across. run() hands out job indices to
+// the workers and the calling thread alike, and returns once every job is
+// done. With no threads, run() just loops.
+class WorkerPool {
+public:
+  explicit WorkerPool(size_t threads);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // Call fn(i) for each i in [0, jobs). Not reentrant.
+  void run(size_t jobs, const std::function<void(size_t)> &fn);
+  size_t threads() const { return workers_.size(); }
+
+private:
+  void work();
+  void drain();
+
+  std::vector<std::thread> workers_;
+  std::mutex mtx_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(size_t)> *fn_ = nullptr;
+  size_t jobs_ = 0;
+  std::atomic<size_t> next_ = 0;
+  // workers yet to finish the current batch
+  size_t busy_ = 0;
+  uint64_t batch_ = 0;
+  bool quit_ = false;
+};
+
+} // namespace util
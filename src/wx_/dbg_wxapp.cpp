@@ -41,6 +41,7 @@ wxBEGIN_EVENT_TABLE(DebuggerFrame, wxFrame)
   EVT_CHECKBOX(constants::MUTE_P2, DebuggerFrame::OnMutePulse2)
   EVT_CHECKBOX(constants::MUTE_TR, DebuggerFrame::OnMuteTriangle)
   EVT_CHECKBOX(constants::MUTE_NS, DebuggerFrame::OnMuteNoise)
+  EVT_CHECKBOX(constants::MUTE_DMC, DebuggerFrame::OnMuteDmc)
 wxEND_EVENT_TABLE();
 // clang-format on
 
@@ -88,7 +89,7 @@ void CPUStateTable::OnPaint(wxPaintEvent &event) {
   SetCellValue(5, 0, ss.str());
   ss.str(std::string());
 
-  ss << std::dec << +st.cycle;
+  ss << std::dec << _console->cycle();
   SetCellValue(6, 0, ss.str());
   ss.str(std::string());
 }
@@ -160,6 +161,8 @@ DebuggerFrame::DebuggerFrame() : wxFrame(NULL, wxID_ANY, "ohNES CPU debugger") {
                     wxSizerFlags().Border(wxALL, 7));
   muteBoxSizer->Add(new wxCheckBox(p, constants::MUTE_NS, "Mute Noise"),
                     wxSizerFlags().Border(wxALL, 7));
+  muteBoxSizer->Add(new wxCheckBox(p, constants::MUTE_DMC, "Mute DMC"),
+                    wxSizerFlags().Border(wxALL, 7));
 
   sizerCPUStateWin->Add(muteBoxSizer,
                         wxSizerFlags(1).Expand().Border(wxALL, 7));
@@ -177,7 +180,7 @@ DebuggerFrame::DebuggerFrame() : wxFrame(NULL, wxID_ANY, "ohNES CPU debugger") {
   _bp_dialog->SetValue("Enter an address in PRG memory");
 
   _bp_disable = new wxNumberEntryDialog(p, "Select", "Index",
-                                        "Disable Breakpoint", -1, -1, 31);
+                                        "Disable Breakpoint", -1, -1, 0xFFFF);
 
   topsizer->Fit(this);
 }
@@ -242,6 +245,9 @@ void DebuggerFrame::OnMuteTriangle(wxCommandEvent &event) {
 void DebuggerFrame::OnMuteNoise(wxCommandEvent &event) {
   _console->debugger().muteApuChannel(3, event.IsChecked());
 }
+void DebuggerFrame::OnMuteDmc(wxCommandEvent &event) {
+  _console->debugger().muteApuChannel(4, event.IsChecked());
+}
 
 void TraceScrollWindow::OnDraw(wxDC &dc) {
   int y = 0;
@@ -272,10 +278,11 @@ void TraceScrollWindow::OnDraw(wxDC &dc) {
 
 void BreakpointScrollWindow::OnDraw(wxDC &dc) {
   int y = 0;
-  const auto &bps = console->debugger().breakpoints();
+  // NOTE(oren): the emulation thread owns the breakpoints, this is a copy
+  const auto &bps = console->debugger().listing();
   for (int i = 0; i < bps.size(); ++i) {
-    const auto &bp = *bps[i];
-    if (bp.isEnabled()) {
+    const auto &bp = bps[i];
+    if (bp.enabled) {
       dc.SetTextForeground(*wxRED);
     } else {
       dc.SetTextForeground(*wxBLUE);
@@ -283,7 +290,7 @@ void BreakpointScrollWindow::OnDraw(wxDC &dc) {
     int yPhys;
     CalcScrolledPosition(0, y, NULL, &yPhys);
     std::stringstream ss;
-    ss << std::uppercase << i << " | " << bp.str();
+    ss << std::uppercase << i << " | " << bp.desc;
     dc.DrawText(wxString::Format("%s", ss.str().c_str()), 0, y);
     y += line_height;
   }
@@ -136,6 +136,7 @@ public:
   void OnMutePulse2(wxCommandEvent &event);
   void OnMuteTriangle(wxCommandEvent &event);
   void OnMuteNoise(wxCommandEvent &event);
+  void OnMuteDmc(wxCommandEvent &event);
 
   void SetConsole(sys::NES *console) {
     _console = console;
@@ -191,6 +192,7 @@ enum {
   MUTE_P2,
   MUTE_TR,
   MUTE_NS,
+  MUTE_DMC,
   TABLE_PAINT,
   QUIT = wxID_EXIT,
   ABOUT = wxID_ABOUT,
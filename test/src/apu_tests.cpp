@@ -1,5 +1,9 @@
 #include "test_util.hpp"
 
+#include <iterator>
+#include <random>
+#include <vector>
+
 TEST(ApuTest, LengthCounter) {
   BLARGG_TEST_MEM("rom/1-len_ctr.nes", 0x6000, 0x00);
 }
@@ -33,3 +37,157 @@ TEST(ApuTest, Reset) {
   BLARGG_TEST("rom/irq_flag_cleared.nes");
   BLARGG_TEST("rom/works_immediately.nes");
 }
+
+// Channels only re-decode their registers after a write that marks them
+// dirty, so a register change is picked up by the channel it belongs to and
+// no other.
+TEST(ApuTest, ConfigDirty) {
+  using CName = aud::Registers::CName;
+  StubMapper m;
+  aud::Registers regs;
+  aud::APU apu(m, regs);
+  auto status = [&] { return regs.read(CName::STATUS, m) & 0x0F; };
+
+  // disabling every channel clears the length counters loaded at power on
+  regs.write(CName::STATUS, 0x00, m);
+  apu.step();
+  EXPECT_EQ(status(), 0);
+
+  // $4015 dirties every channel. With the bits taken nothing is reconfigured,
+  // so the channels stay disabled for now.
+  regs.write(CName::STATUS, 0x0F, m);
+  for (int id = 0; id < 4; ++id) {
+    EXPECT_TRUE(regs.configDirty(aud::ChannelId(id)));
+    EXPECT_FALSE(regs.configDirty(aud::ChannelId(id)));
+  }
+  apu.step();
+  EXPECT_EQ(status(), 0);
+
+  // a write only marks the channel it belongs to
+  regs.write(CName::P1_TLO, 0x40, m);
+  EXPECT_TRUE(regs.configDirty(aud::ChannelId::PULSE_1));
+  EXPECT_FALSE(regs.configDirty(aud::ChannelId::PULSE_2));
+  EXPECT_FALSE(regs.configDirty(aud::ChannelId::TRIANGLE));
+  EXPECT_FALSE(regs.configDirty(aud::ChannelId::NOISE));
+  regs.write(CName::DMC_CTRL, 0x0F, m);
+  for (int id = 0; id < 4; ++id) {
+    EXPECT_FALSE(regs.configDirty(aud::ChannelId(id)));
+  }
+
+  // load both pulse length counters, but take pulse 2's dirty bit so it looks
+  // clean. Only pulse 1 is reconfigured, enabled and picks up its length.
+  regs.write(CName::P1_THI, 0x08, m);
+  regs.write(CName::P2_THI, 0x08, m);
+  regs.configDirty(aud::ChannelId::PULSE_2);
+  apu.step();
+  EXPECT_EQ(status(), 0b0001);
+  apu.step();
+  EXPECT_EQ(status(), 0b0001);
+
+  // until something dirties pulse 2 again
+  regs.write(CName::P2_TLO, 0x40, m);
+  apu.step();
+  EXPECT_EQ(status(), 0b0011);
+}
+
+// run() skips ahead in bulk wherever it can, which must be invisible: the
+// same register traffic has to produce the same samples, status, IRQ line and
+// DMC fetches as stepping one cycle at a time.
+TEST(ApuTest, RunMatchesStep) {
+  using CName = aud::Registers::CName;
+  struct Side {
+    StubMapper m;
+    aud::Registers regs;
+    aud::APU apu{m, regs};
+    std::vector<uint64_t> stalls;
+    std::vector<int16_t> samples;
+    uint64_t cycle = 0;
+
+    void drain() {
+      int16_t buf[1024];
+      while (auto n = apu.output().pop(buf, std::size(buf))) {
+        samples.insert(samples.end(), buf, buf + n);
+      }
+    }
+  };
+  Side step, run;
+
+  std::mt19937 rng(4015);
+  for (auto *side : {&step, &run}) {
+    std::mt19937 fill(6502);
+    for (auto &b : side->m.mem) {
+      b = static_cast<uint8_t>(fill());
+    }
+  }
+
+  for (int i = 0; i < 3000; ++i) {
+    // a few writes, mostly to the tone channels, keeping them enabled
+    for (int w = rng() % 4; w > 0; --w) {
+      auto r = static_cast<CName>(rng() % CName::N_REGS);
+      auto v = static_cast<uint8_t>(rng());
+      if (r == CName::_1 || r == CName::_2) {
+        r = CName::STATUS;
+      }
+      if (r == CName::STATUS) {
+        v |= 0x0F;
+      } else if (r == CName::FRAME_CNT) {
+        v &= 0xC0;
+      }
+      step.regs.write(r, v, step.m);
+      run.regs.write(r, v, run.m);
+    }
+    if (rng() % 8 == 0) {
+      ASSERT_EQ(step.regs.read(CName::STATUS, step.m),
+                run.regs.read(CName::STATUS, run.m));
+    }
+
+    uint32_t n = 1 + rng() % (rng() % 4 == 0 ? 30000 : 300);
+    for (uint32_t c = 0; c < n; ++c) {
+      step.apu.step();
+      ++step.cycle;
+      if (step.apu.stallCpu()) {
+        step.stalls.push_back(step.cycle);
+      }
+    }
+    while (n > 0) {
+      auto k = run.apu.run(n);
+      n -= k;
+      run.cycle += k;
+      if (run.apu.stallCpu()) {
+        run.stalls.push_back(run.cycle);
+      }
+    }
+
+    ASSERT_EQ(step.apu.pendingIrq(), run.apu.pendingIrq()) << "interval " << i;
+    ASSERT_EQ(step.regs.read(CName::STATUS, step.m),
+              run.regs.read(CName::STATUS, run.m));
+    step.drain();
+    run.drain();
+    ASSERT_EQ(step.samples, run.samples) << "interval " << i;
+    ASSERT_EQ(step.stalls, run.stalls) << "interval " << i;
+  }
+  EXPECT_GT(step.stalls.size(), 0u);
+  EXPECT_GT(step.samples.size(), 0u);
+}
+
+// Two runs of the same ROM must produce the same audio, frame for frame.
+TEST(ApuTest, AudioHash) {
+  constexpr int Frames = 120;
+  auto run = [] {
+    NES nes("rom/square.nes", false, true);
+    aud::NullSink sink;
+    nes.setAudioSink(sink);
+    for (int i = 0; i < Frames; ++i) {
+      do {
+        nes.step();
+      } while (!nes.checkFrame());
+      sink.frame();
+    }
+    EXPECT_GT(sink.samples(), 0u);
+    return sink.hashes();
+  };
+
+  auto first = run();
+  EXPECT_EQ(first.size(), Frames);
+  EXPECT_EQ(first, run());
+}
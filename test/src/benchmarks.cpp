@@ -0,0 +1,138 @@
+// Throughput benchmarks. These report numbers for comparing changes rather
+// than pass or fail, so they're a plain executable and not part of ctest.
+//   ./benchmarks apu          the APU alone, on a stub mapper, stepped once
+//                             per cycle and caught up in bulk
+//   ./benchmarks filter       the output filter stage alone
+//   ./benchmarks rom <file>   the whole console, headless
+
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_us(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+// NTSC CPU cycles per video frame, near enough
+constexpr uint32_t FrameCycles = 29781;
+
+// All four tone channels sounding, with a few register writes per frame the
+// way a music driver would. Either one step() per CPU cycle, or run() over
+// as many cycles as the console would let the APU fall behind by.
+void bench_apu(int frames, bool bulk) {
+  using CName = aud::Registers::CName;
+  StubMapper m;
+  aud::Registers regs;
+  aud::APU apu(m, regs);
+  std::vector<int16_t> drain(4096);
+
+  regs.write(CName::STATUS, 0x0F, m);
+  regs.write(CName::P1_CTRL, 0xBF, m);
+  regs.write(CName::P2_CTRL, 0x7F, m);
+  regs.write(CName::TR_CTRL, 0xFF, m);
+  regs.write(CName::NS_CTRL, 0x3F, m);
+  regs.write(CName::NS_LNP, 0x04, m);
+  regs.write(CName::NS_LCL, 0x08, m);
+
+  auto start = Clock::now();
+  for (int f = 0; f < frames; ++f) {
+    regs.write(CName::P1_TLO, 0xFD - (f & 0x3F), m);
+    regs.write(CName::P1_THI, 0x08, m);
+    regs.write(CName::P2_TLO, 0x7E + (f & 0x1F), m);
+    regs.write(CName::P2_THI, 0x09, m);
+    regs.write(CName::TR_TLO, 0x40 + (f & 0x7F), m);
+    regs.write(CName::TR_THI, 0x08, m);
+    if (bulk) {
+      for (uint32_t c = 0; c < FrameCycles;) {
+        c += apu.run(std::min(FrameCycles - c, apu.deferrableSteps()));
+        apu.stallCpu();
+      }
+    } else {
+      for (uint32_t c = 0; c < FrameCycles; ++c) {
+        apu.step();
+      }
+    }
+    while (apu.output().pop(drain.data(), drain.size()) > 0) {
+    }
+  }
+  auto us = elapsed_us(start);
+
+  double cycles = static_cast<double>(frames) * FrameCycles;
+  std::cout << (bulk ? "apu run: " : "apu step: ") << cycles << " cycles in "
+            << us / 1000.0 << " ms, " << cycles / us << " cycles/us, "
+            << 1000.0 * us / cycles << " ns/cycle" << std::endl;
+}
+
+// A loud square wave with some hash on it, fed through in synthesis frame
+// sized blocks the way the APU does. The APU runs one filter for the mix and
+// five more for stems, all at SampleRate.
+void bench_filter(int seconds) {
+  constexpr size_t Frame = 108;
+  std::vector<float> in(64 * Frame);
+  std::vector<int16_t> out(in.size());
+  uint32_t lcg = 1;
+  for (size_t i = 0; i < in.size(); ++i) {
+    lcg = lcg * 1664525u + 1013904223u;
+    in[i] = ((i / 55) & 1 ? 20000.0f : -8000.0f) + (lcg >> 20) - 2048.0f;
+  }
+  aud::OutputFilter filter(aud::SampleRate);
+
+  size_t total = static_cast<size_t>(seconds) * aud::SampleRate;
+  size_t done = 0;
+  auto start = Clock::now();
+  while (done < total) {
+    for (size_t i = 0; i < in.size() && done < total; i += Frame) {
+      filter.process(in.data() + i, out.data() + i, Frame);
+      done += Frame;
+    }
+  }
+  auto us = elapsed_us(start);
+
+  std::cout << "filter: " << done << " samples in " << us / 1000.0 << " ms, "
+            << 1000.0 * us / done << " ns/sample, "
+            << done * 1e6 / us / aud::SampleRate << "x real time"
+            << std::endl;
+}
+
+void bench_rom(const std::string &romfile, int frames) {
+  NES nes(romfile, false, true);
+  auto start = Clock::now();
+  for (int i = 0; i < frames; ++i) {
+    do {
+      nes.step();
+    } while (!nes.checkFrame());
+  }
+  auto us = elapsed_us(start);
+
+  std::cout << "rom: " << frames << " frames (" << nes.cycle()
+            << " cycles) in " << us / 1000.0 << " ms, "
+            << frames * 1e6 / us << " frames/s" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string what = argc > 1 ? argv[1] : "";
+  if (what == "apu") {
+    bench_apu(600, false);
+    bench_apu(600, true);
+  } else if (what == "filter") {
+    bench_filter(600);
+  } else if (what == "rom" && argc > 2) {
+    bench_rom(argv[2], 600);
+  } else {
+    std::cerr << "usage: " << argv[0] << " apu | filter | rom <file>"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
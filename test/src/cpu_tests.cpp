@@ -14,6 +14,55 @@ TEST(CpuTest, Nestest) {
   EXPECT_EQ(nes.mapper().read(0x0003), 0x00);
 }
 
+// DMA halts count towards NES::cycle() but not the CPU's own cycle count, with
+// an alignment cycle when they start on a put (odd) cycle
+TEST(CpuTest, DmaCycles) {
+  NES nes("rom/nestest.nes", false, true);
+  nes.reset(static_cast<uint16_t>(0xc000));
+
+  // halted cycles picked up over the next instruction
+  auto halted = [&nes] {
+    uint64_t cpu = nes.state().cycle;
+    uint64_t total = nes.cycle();
+    nes.step();
+    return nes.cycle() - total - (nes.state().cycle - cpu);
+  };
+
+  bool seen[2] = {false, false};
+  for (int i = 0; i < 16; ++i) {
+    auto c = nes.mapper().cycle();
+    nes.mapper().write(0x4014, 0x02);
+    EXPECT_EQ(halted(), 513u + (c & 1));
+    seen[c & 1] = true;
+  }
+  EXPECT_TRUE(seen[0] && seen[1]);
+
+  // a one byte sample from $C000. Enabling the DMC fetches it on the next
+  // APU step, one cycle on. Disabling it again empties the buffer for the
+  // next round.
+  nes.mapper().write(0x4010, 0x00);
+  nes.mapper().write(0x4012, 0x00);
+  nes.mapper().write(0x4013, 0x00);
+  seen[0] = seen[1] = false;
+  for (int i = 0; i < 16; ++i) {
+    nes.mapper().write(0x4015, 0x00);
+    EXPECT_EQ(halted(), 0u);
+    auto c = nes.mapper().cycle() + 1;
+    nes.mapper().write(0x4015, 0x10);
+    EXPECT_EQ(halted(), 3u + (c & 1));
+    seen[c & 1] = true;
+  }
+  EXPECT_TRUE(seen[0] && seen[1]);
+
+  // inside an OAM transfer the fetch only steals 2 cycles
+  nes.mapper().write(0x4015, 0x00);
+  EXPECT_EQ(halted(), 0u);
+  auto c = nes.mapper().cycle();
+  nes.mapper().write(0x4014, 0x02);
+  nes.mapper().write(0x4015, 0x10);
+  EXPECT_EQ(halted(), 513u + (c & 1) + 2);
+}
+
 TEST(CpuTest, InstTestV5_Basics) { BLARGG_TEST("rom/01-basics.nes"); }
 TEST(CpuTest, InstTestV5_Implied) { BLARGG_TEST("rom/02-implied.nes"); }
 TEST(CpuTest, InstTestV5_Immediate) { BLARGG_TEST("rom/03-immediate.nes"); }
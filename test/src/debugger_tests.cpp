@@ -0,0 +1,118 @@
+#include "test_util.hpp"
+
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A 64KiB UxROM image. Banks 0 and 1 both hold `STA $10; RTS` at $8000, and
+// the fixed bank calls into each in turn.
+class BankedRom {
+public:
+  BankedRom() : path_(temp_path(".nes")) {
+    constexpr size_t Bank = 0x4000;
+    std::vector<uint8_t> prg(4 * Bank, 0xEA);
+    const std::vector<uint8_t> sub = {0x85, 0x10, 0x60};
+    std::copy(sub.begin(), sub.end(), prg.begin());
+    std::copy(sub.begin(), sub.end(), prg.begin() + Bank);
+    const std::vector<uint8_t> main = {
+        0xA2, 0xFF, 0x9A,             // C000 LDX #$FF / TXS
+        0xA9, 0x00, 0x8D, 0x00, 0x80, // C003 LDA #$00 / STA $8000
+        0x20, 0x00, 0x80,             // C008 JSR $8000
+        0xA9, 0x01, 0x8D, 0x00, 0x80, // C00B LDA #$01 / STA $8000
+        0x20, 0x00, 0x80,             // C010 JSR $8000
+        0xA5, 0x10,                   // C013 LDA $10
+        0x4C, 0x15, 0xC0,             // C015 JMP $C015
+    };
+    std::copy(main.begin(), main.end(), prg.begin() + 3 * Bank);
+    // NMI, reset and IRQ vectors
+    const std::vector<uint8_t> vectors = {0x15, 0xC0, 0x00, 0xC0, 0x15, 0xC0};
+    std::copy(vectors.begin(), vectors.end(), prg.end() - vectors.size());
+
+    // 4x16KiB PRG, 1x8KiB CHR, mapper 2
+    std::vector<uint8_t> rom = {'N', 'E', 'S', 0x1A, 4, 1, 0x20, 0,
+                                0,   0,   0,   0,    0, 0, 0,    0};
+    rom.insert(rom.end(), prg.begin(), prg.end());
+    rom.resize(rom.size() + 0x2000, 0);
+    std::ofstream out(path_, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(rom.data()), rom.size());
+  }
+  ~BankedRom() { std::filesystem::remove(path_); }
+
+  std::string path() const { return path_.string(); }
+
+private:
+  std::filesystem::path path_;
+};
+
+bool run_to_break(NES &nes) {
+  for (int i = 0; i < 100 && !nes.paused(); ++i) {
+    nes.step();
+  }
+  return nes.debugger().mode() == NESDebugger::Mode::BREAK;
+}
+
+} // namespace
+
+TEST(DebuggerTest, WriteWatchpoint) {
+  BankedRom rom;
+  NES nes(rom.path(), true, true);
+  nes.debugger().setBreakpoint<Watchpoint>(true, "w:0010");
+
+  // breaks on the instruction after the first STA $10, in bank 0
+  ASSERT_TRUE(run_to_break(nes));
+  EXPECT_EQ(nes.state().pc, 0x8002);
+  EXPECT_EQ(nes.mapper().prgRomOffset(nes.state().pc), 0x0002);
+  EXPECT_EQ(nes.state().rA, 0x00);
+}
+
+TEST(DebuggerTest, ReadWatchpoint) {
+  BankedRom rom;
+  NES nes(rom.path(), true, true);
+  // the stores to $10 go through the same watched page, but mustn't fire
+  nes.debugger().setBreakpoint<Watchpoint>(true, "r:0010");
+
+  ASSERT_TRUE(run_to_break(nes));
+  EXPECT_EQ(nes.state().pc, 0xC015);
+  EXPECT_EQ(nes.state().rA, 0x01);
+}
+
+TEST(DebuggerTest, PrgBreakpoint) {
+  BankedRom rom;
+  NES nes(rom.path(), true, true);
+  // $8000 in bank 1. The same PC in bank 0 runs first and mustn't fire.
+  nes.debugger().setBreakpoint<PrgBreakpoint>(true, "4000");
+
+  ASSERT_TRUE(run_to_break(nes));
+  EXPECT_EQ(nes.state().pc, 0x8000);
+  EXPECT_EQ(nes.mapper().prgRomOffset(nes.state().pc), 0x4000);
+  EXPECT_EQ(nes.state().rA, 0x01);
+}
+
+// The debugger UI sets breakpoints from its own thread. They're queued and
+// only reach the emulation thread's list at an instruction boundary.
+TEST(DebuggerTest, EditsFromAnotherThread) {
+  BankedRom rom;
+  NES nes(rom.path(), true, true);
+  auto &dbg = nes.debugger();
+  std::thread([&] {
+    dbg.setBreakpoint<PcBreakpoint>(true, static_cast<uint16_t>(0xC015));
+  }).join();
+  EXPECT_TRUE(dbg.breakpoints().empty());
+  EXPECT_TRUE(dbg.listing().empty());
+
+  ASSERT_TRUE(run_to_break(nes));
+  EXPECT_EQ(nes.state().pc, 0xC015);
+  ASSERT_EQ(dbg.listing().size(), 1u);
+  EXPECT_TRUE(dbg.listing()[0].enabled);
+
+  // while paused, the console applies edits without running anything
+  std::thread([&] { dbg.disableBreakpoint(0); }).join();
+  auto cycle = nes.cycle();
+  nes.step();
+  EXPECT_EQ(nes.cycle(), cycle);
+  ASSERT_EQ(dbg.listing().size(), 1u);
+  EXPECT_FALSE(dbg.listing()[0].enabled);
+  EXPECT_FALSE(dbg.breakpoints()[0]->isEnabled());
+}
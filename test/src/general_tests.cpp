@@ -1,9 +1,33 @@
+#include "test_util.hpp"
+
 #include "util.hpp"
 
+#include "capture.hpp"
+#include "dbg/breakpoint.hpp"
+#include "frame_pacer.hpp"
+#include "frame_queue.hpp"
+#include "joypad.hpp"
+#include "latency_probe.hpp"
+#include "mappers/dma.hpp"
+#include "ntsc_filter.hpp"
+#include "output_filter.hpp"
 #include "ppu.hpp"
+#include "sample_queue.hpp"
+#include "upscaler.hpp"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
 constexpr size_t RB_CAP = 32;
 constexpr size_t EXTRA = 45;
 
@@ -61,3 +85,563 @@ TEST(General, SpriteLayout) {
   EXPECT_EQ(sprite.s.attrs.s.h_flip, 0b0u);
   EXPECT_EQ(sprite.s.attrs.s.v_flip, 0b1u);
 }
+
+TEST(General, AddressMap) {
+  sys::AddressMap map(0x10000);
+
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.test(0x8000));
+
+  map.set(0x8000);
+  map.set(0x8000);
+  map.set(0xFFFF);
+  map.set(0x10000);
+
+  EXPECT_EQ(map.count(), 2u);
+  EXPECT_TRUE(map.test(0x8000));
+  EXPECT_TRUE(map.test(0xFFFF));
+  EXPECT_FALSE(map.test(0x8001));
+  EXPECT_FALSE(map.test(0x10000));
+
+  EXPECT_TRUE(map.testPage(0x8000));
+  EXPECT_TRUE(map.testPage(0xFF00));
+  EXPECT_FALSE(map.testPage(0x8100));
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.test(0x8000));
+}
+
+TEST(General, BreakpointSpecs) {
+  sys::BreakMaps maps;
+  maps.prg.resize(0x20000);
+
+  sys::Watchpoint w(true, "rw:$6000-7FFF");
+  EXPECT_EQ(w.str(), "RW- 0x6000-0x7fff");
+  EXPECT_TRUE(w.arm(maps));
+  EXPECT_EQ(maps.read.count(), 0x2000u);
+  EXPECT_EQ(maps.write.count(), 0x2000u);
+  EXPECT_TRUE(maps.pc.empty());
+
+  maps.clear();
+  EXPECT_TRUE(sys::Watchpoint(true, "X:0-ffff").arm(maps));
+  EXPECT_EQ(maps.pc.count(), 0x10000u);
+
+  sys::PrgBreakpoint p(true, "1C010");
+  EXPECT_TRUE(p.arm(maps));
+  EXPECT_TRUE(maps.prg.test(0x1C010));
+
+  EXPECT_THROW(sys::Watchpoint(true, "0300"), std::invalid_argument);
+  EXPECT_THROW(sys::Watchpoint(true, ":0300"), std::invalid_argument);
+  EXPECT_THROW(sys::Watchpoint(true, "q:0300"), std::invalid_argument);
+  EXPECT_THROW(sys::Watchpoint(true, "w:10000"), std::invalid_argument);
+  EXPECT_THROW(sys::Watchpoint(true, "w:0300-02FF"), std::invalid_argument);
+  EXPECT_THROW(sys::Watchpoint(true, "w:03G0"), std::invalid_argument);
+  EXPECT_THROW(sys::PrgBreakpoint(true, ""), std::invalid_argument);
+  EXPECT_THROW(sys::PrgBreakpoint(true, "-1"), std::invalid_argument);
+}
+
+TEST(General, Expression) {
+  EXPECT_NO_THROW(sys::Expression("A == $3F && [$00FF] > 4 && scanline > 9"));
+  EXPECT_NO_THROW(sys::Expression("(X + 1) % 3 != %101 || [[$10] + Y] == 0"));
+  EXPECT_THROW(sys::Expression("A =="), std::invalid_argument);
+  EXPECT_THROW(sys::Expression("(A"), std::invalid_argument);
+  EXPECT_THROW(sys::Expression("Q > 1"), std::invalid_argument);
+  EXPECT_THROW(sys::Expression("A # 1"), std::invalid_argument);
+
+  // literals are anything that fits in 32 bits
+  EXPECT_NO_THROW(sys::Expression("A == 4294967295 || A == $FFFFFFFF"));
+  EXPECT_THROW(sys::Expression("A == 4294967296"), std::invalid_argument);
+  EXPECT_THROW(sys::Expression("A == $100000000"), std::invalid_argument);
+  EXPECT_THROW(sys::Expression("A == 99999999999999999999"),
+               std::invalid_argument);
+  EXPECT_THROW(sys::Expression("A == %2"), std::invalid_argument);
+
+  std::string spec = "C000:A == 1";
+  EXPECT_EQ(sys::Expression::SplitPc(spec), 0xC000);
+  EXPECT_EQ(spec, "A == 1");
+
+  spec = "$8F:X";
+  EXPECT_EQ(sys::Expression::SplitPc(spec), 0x008F);
+  EXPECT_EQ(spec, "X");
+
+  spec = "A={A} sl={scanline:d}";
+  EXPECT_EQ(sys::Expression::SplitPc(spec), std::nullopt);
+  EXPECT_EQ(spec, "A={A} sl={scanline:d}");
+}
+
+TEST(General, ExpressionEval) {
+  cpu::CpuState cpu{};
+  cpu.rA = 0x3F;
+  cpu.rX = 2;
+  cpu.rY = 0x10;
+  cpu.sp = 0xFD;
+  cpu.status = 0x24;
+  cpu.pc = 0xC123;
+  StubMapper m;
+  m.mem[0x00FF] = 5;
+  m.mem[0x0010] = 0x20;
+  m.mem[0x0030] = 0x7E;
+  std::ostringstream trace;
+  sys::ExprContext ctx{cpu, m, 241, 17, trace};
+  auto eval = [&](const std::string &src) {
+    return sys::Expression(src).eval(ctx);
+  };
+
+  // operands
+  EXPECT_EQ(eval("A"), 0x3F);
+  EXPECT_EQ(eval("X + Y * 2"), 0x22);
+  EXPECT_EQ(eval("SP"), 0xFD);
+  EXPECT_EQ(eval("P"), 0x24);
+  EXPECT_EQ(eval("PC"), 0xC123);
+  EXPECT_EQ(eval("scanline"), 241);
+  EXPECT_EQ(eval("dot"), 17);
+  EXPECT_EQ(eval("cycle"), 17);
+  EXPECT_EQ(eval("bank"), 2);
+  EXPECT_EQ(eval("[$00FF]"), 5);
+  EXPECT_EQ(eval("[[$10] + Y]"), 0x7E);
+  EXPECT_EQ(eval("0x10 + %101 + 10"), 31);
+
+  // precedence and associativity follow C
+  EXPECT_EQ(eval("1 + 2 * 3"), 7);
+  EXPECT_EQ(eval("(1 + 2) * 3"), 9);
+  EXPECT_EQ(eval("10 - 4 - 3"), 3);
+  EXPECT_EQ(eval("1 << 2 + 1"), 8);
+  EXPECT_EQ(eval("1 | 2 ^ 3 & 6"), 1 | (2 ^ (3 & 6)));
+  EXPECT_EQ(eval("1 < 2 == 1"), 1);
+  EXPECT_EQ(eval("0 || 1 && 0"), 0);
+  EXPECT_EQ(eval("-A + 1"), -0x3E);
+  EXPECT_EQ(eval("!A"), 0);
+  EXPECT_EQ(eval("~0"), -1);
+  EXPECT_EQ(eval("7 / 2 + 7 % 2"), 4);
+
+  // the stack goes deep enough for nested operands
+  EXPECT_EQ(eval("1 + (2 + (3 + (4 + (5 + (6 + (7 + 8))))))"), 36);
+
+  // degenerate cases are defined rather than trapping
+  EXPECT_EQ(eval("A / 0"), 0);
+  EXPECT_EQ(eval("A % 0"), 0);
+  EXPECT_EQ(eval("-1 << 4"), -16);
+  EXPECT_EQ(eval("$7FFFFFFF + 1"), INT32_MIN);
+  EXPECT_EQ(eval("$FFFFFFFF"), -1);
+  EXPECT_EQ(eval("4294967295 == -1"), 1);
+  EXPECT_EQ(eval("(0 - $7FFFFFFF - 1) / -1"), INT32_MIN);
+
+  // a PC-guarded breakpoint is indexed by its PC and fires only when its
+  // condition holds
+  sys::CondBreakpoint bp(true, 0xC123, "A == $3F && [$00FF] > 4");
+  sys::BreakMaps maps;
+  EXPECT_TRUE(bp.arm(maps));
+  EXPECT_TRUE(maps.guarded.test(0xC123));
+  EXPECT_FALSE(maps.pc.test(0xC123));
+  ASSERT_EQ(maps.at_pc.count(0xC123), 1u);
+  EXPECT_EQ(maps.at_pc.find(0xC123)->second, &bp);
+
+  instr::Instruction in(0xEA, 0xC123, 0);
+  EXPECT_TRUE(bp.evaluate(in, ctx));
+  m.mem[0x00FF] = 4;
+  EXPECT_FALSE(bp.evaluate(in, ctx));
+  m.mem[0x00FF] = 5;
+  bp.enable(false);
+  EXPECT_FALSE(bp.evaluate(in, ctx));
+
+  // tracepoints print their fields and never break
+  sys::Tracepoint tp(true, 0xC123, "A={A} sl={scanline:d}");
+  EXPECT_FALSE(tp.evaluate(in, ctx));
+  EXPECT_EQ(trace.str(), "TRACE 0xc123: A=3f sl=241\n");
+}
+
+TEST(General, Dma) {
+  mapper::DMA dma;
+  // take and retire the halted cycles, like the console does
+  auto drain = [&dma] {
+    auto n = dma.take();
+    for (int i = 0; i < n; ++i) {
+      dma.clock();
+    }
+    EXPECT_FALSE(dma.active());
+    return n;
+  };
+
+  // OAM and DMC take an extra alignment cycle when they start on a put (odd)
+  // cycle
+  dma.oam(100);
+  EXPECT_EQ(drain(), 513);
+  dma.oam(101);
+  EXPECT_EQ(drain(), 514);
+  dma.dmc(100);
+  EXPECT_EQ(drain(), 3);
+  dma.dmc(101);
+  EXPECT_EQ(drain(), 4);
+  EXPECT_EQ(drain(), 0);
+
+  // inside a running OAM transfer a DMC fetch takes 2 cycles whatever the
+  // parity, and stretches the transfer by as much
+  dma.oam(100);
+  dma.dmc(100);
+  dma.dmc(101);
+  EXPECT_EQ(drain(), 513 + 2 + 2);
+
+  // or partway through, while the console is clocking the transfer
+  dma.oam(101);
+  EXPECT_EQ(dma.take(), 514);
+  for (int i = 0; i < 514; ++i) {
+    if (i == 100) {
+      dma.dmc(201);
+    }
+    dma.clock();
+  }
+  EXPECT_EQ(drain(), 2);
+}
+
+TEST(General, SampleQueue) {
+  aud::SampleQueue q(64);
+  std::vector<int16_t> in(48), out(48);
+  std::iota(in.begin(), in.end(), 0);
+
+  // straddle the end of the ring a few times
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(q.push(in.data(), in.size()), in.size());
+    EXPECT_EQ(q.size(), in.size());
+    EXPECT_EQ(q.pop(out.data(), out.size()), out.size());
+    EXPECT_EQ(out, in);
+  }
+
+  EXPECT_EQ(q.push(in.data(), in.size()), 48u);
+  EXPECT_EQ(q.push(in.data(), in.size()), 16u);
+  EXPECT_EQ(q.pop(out.data(), out.size()), 48u);
+  EXPECT_EQ(q.pop(out.data(), out.size()), 16u);
+  EXPECT_EQ(out[15], 15);
+
+  auto stats = q.stats();
+  EXPECT_EQ(stats.dropped, 32u);
+  EXPECT_EQ(stats.underruns, 1u);
+  EXPECT_EQ(stats.max_fill, 64u);
+  EXPECT_EQ(stats.pushed, stats.popped);
+
+  EXPECT_THROW(aud::SampleQueue(48), std::invalid_argument);
+}
+
+TEST(General, FrameQueue) {
+  auto q = std::make_unique<vid::FrameQueue>();
+  auto mark = [&](uint8_t v) { q->back()[0] = v; };
+
+  EXPECT_FALSE(q->acquire());
+
+  mark(1);
+  q->publish();
+  EXPECT_TRUE(q->acquire());
+  EXPECT_EQ(q->front()[0], 1);
+  EXPECT_FALSE(q->acquire());
+
+  // the consumer only ever sees the latest frame, and the producer never
+  // draws into the one it's looking at
+  mark(2);
+  q->publish();
+  mark(3);
+  q->publish();
+  EXPECT_NE(&q->back(), static_cast<const void *>(q->front().data()));
+  EXPECT_TRUE(q->acquire());
+  EXPECT_EQ(q->front()[0], 3);
+  EXPECT_NE(&q->back(), static_cast<const void *>(q->front().data()));
+  EXPECT_EQ(q->published(), 3u);
+
+  // identical frames hash the same, and a single dot changes just its row
+  auto draw = [&](uint8_t dot) {
+    std::fill(q->back().begin(), q->back().end(), vid::Pixel{});
+    q->back()[7 * vid::WIDTH + 200] = dot;
+    for (size_t y = 0; y < vid::HEIGHT; ++y) {
+      q->finishRow(y);
+    }
+    q->publish();
+    q->acquire();
+  };
+  draw(0);
+  auto rows = q->frontRows();
+  vid::RowHashes before;
+  std::copy(rows.begin(), rows.end(), before.begin());
+  auto hash = q->frontHash();
+  draw(0);
+  EXPECT_EQ(q->frontHash(), hash);
+  draw(1);
+  EXPECT_NE(q->frontHash(), hash);
+  for (size_t y = 0; y < vid::HEIGHT; ++y) {
+    EXPECT_EQ(q->frontRows()[y] != before[y], y == 7) << y;
+  }
+}
+
+TEST(General, TripleBuffer) {
+  util::TripleBuffer<int> b;
+  EXPECT_FALSE(b.acquire());
+  b.back() = 1;
+  b.publish();
+  b.back() = 2;
+  b.publish();
+  EXPECT_TRUE(b.acquire());
+  EXPECT_EQ(b.front(), 2);
+  EXPECT_NE(&b.back(), &b.front());
+  EXPECT_FALSE(b.acquire());
+  EXPECT_EQ(b.front(), 2);
+}
+
+TEST(General, Capture) {
+  auto frames = std::make_unique<vid::FrameQueue>();
+  aud::SampleQueue samples;
+  std::array<vid::Rgb, 512> palette = {};
+  palette[0x30] = {255, 255, 255};
+  auto base = temp_path("").string();
+  std::vector<int16_t> block(800, 1000);
+
+  for (auto format : {sys::Capture::Format::Y4m, sys::Capture::Format::Raw}) {
+    sys::Capture capture(*frames, palette, base, format);
+    capture.open(samples, 48000);
+    for (int i = 0; i < 3; ++i) {
+      std::fill(frames->back().begin(), frames->back().end(),
+                vid::Pixel{0x30});
+      frames->publish();
+      samples.push(block.data(), block.size());
+      capture.frame();
+    }
+    capture.close();
+
+    auto stats = capture.stats();
+    EXPECT_EQ(stats.frames, 3u);
+    EXPECT_EQ(stats.dropped, 0u);
+    EXPECT_EQ(stats.samples, 3 * block.size());
+    EXPECT_EQ(std::filesystem::file_size(base + ".wav"),
+              44 + 3 * block.size() * sizeof(int16_t));
+
+    if (format == sys::Capture::Format::Y4m) {
+      std::ifstream y4m(base + ".y4m", std::ios::binary);
+      std::string header, frame;
+      std::getline(y4m, header);
+      EXPECT_EQ(header, "YUV4MPEG2 W256 H240 F39375000:655171 Ip A8:7 "
+                        "C420jpeg");
+      std::getline(y4m, frame);
+      EXPECT_EQ(frame, "FRAME");
+      // white, in studio range
+      EXPECT_EQ(y4m.get(), 235);
+      EXPECT_EQ(std::filesystem::file_size(base + ".y4m"),
+                header.size() + 1 +
+                    3 * (6 + vid::WIDTH * vid::HEIGHT * 3 / 2));
+    } else {
+      EXPECT_EQ(std::filesystem::file_size(base + ".nesv"),
+                3 * sizeof(vid::FrameBuffer));
+      EXPECT_EQ(std::filesystem::file_size(base + ".pal"), 512u * 3);
+    }
+  }
+
+  // Far more frames than the writer keeps up with, so some are dropped, and
+  // likely the last few. Every one is still written, a repeat standing in
+  // for each drop, and all the audio the queue took makes it out. (Long
+  // runs of drops overflow the queue, which counts that itself.)
+  {
+    constexpr uint64_t Frames = 1000;
+    aud::SampleQueue q;
+    sys::Capture capture(*frames, palette, base, sys::Capture::Format::Y4m);
+    capture.open(q, 48000);
+    for (uint64_t i = 0; i < Frames; ++i) {
+      frames->publish();
+      q.push(block.data(), 64);
+      capture.frame();
+    }
+    capture.close();
+
+    auto stats = capture.stats();
+    EXPECT_EQ(stats.frames, Frames) << stats.dropped << " dropped";
+    EXPECT_EQ(q.size(), 0u);
+    EXPECT_EQ(stats.samples, q.stats().pushed);
+    EXPECT_EQ(std::filesystem::file_size(base + ".wav"),
+              44 + stats.samples * sizeof(int16_t));
+  }
+
+  for (auto ext : {".wav", ".y4m", ".nesv", ".pal"}) {
+    std::filesystem::remove(base + ext);
+  }
+}
+
+TEST(General, NtscFilter) {
+  EXPECT_THROW(vid::NtscFilter(4), std::invalid_argument);
+
+  // a flat field of black decodes to black, and white to near white,
+  // whatever the phase
+  vid::NtscFilter filter(2);
+  auto frame = std::make_unique<vid::FrameBuffer>();
+  std::vector<uint32_t> out(filter.width() * 2);
+  for (uint8_t phase : {0, 4, 8}) {
+    std::fill(frame->begin(), frame->end(), vid::Pixel{0x0F});
+    std::fill(frame->begin() + vid::WIDTH, frame->end(), vid::Pixel{0x30});
+    filter.run(*frame, phase, 0, 2, out.data(), filter.width() * 4);
+    for (size_t x = 8; x + 8 < filter.width(); ++x) {
+      EXPECT_EQ(out[x], 0xFF000000u) << x;
+      uint32_t white = out[filter.width() + x];
+      for (int c = 0; c < 3; ++c) {
+        EXPECT_GT((white >> (8 * c)) & 0xFF, 0xE0u) << x;
+      }
+    }
+  }
+}
+
+// The SSE2 and portable paths agree bit for bit on a frame with every
+// pixel value, emphasis included, and the subcarrier phase moves the
+// artifacts around.
+TEST(General, NtscFilterPaths) {
+  auto frame = std::make_unique<vid::FrameBuffer>();
+  for (size_t i = 0; i < frame->size(); ++i) {
+    (*frame)[i] = static_cast<vid::Pixel>((i * 37 + i / vid::WIDTH * 11) %
+                                          512);
+  }
+
+  for (int scale : {2, 3}) {
+    vid::NtscFilter filter(scale);
+    size_t w = filter.width();
+    auto render = [&](uint8_t phase, bool simd) {
+      std::vector<uint32_t> out(w * vid::HEIGHT);
+      filter.setSimd(simd);
+      filter.run(*frame, phase, 0, vid::HEIGHT, out.data(), w * 4);
+      return out;
+    };
+
+    std::vector<std::vector<uint32_t>> phases;
+    for (uint8_t phase : {0, 4, 8}) {
+      auto simd = render(phase, true);
+      EXPECT_EQ(simd, render(phase, false)) << scale << " " << int(phase);
+      phases.push_back(std::move(simd));
+    }
+    EXPECT_NE(phases[0], phases[1]);
+    EXPECT_NE(phases[1], phases[2]);
+    EXPECT_NE(phases[0], phases[2]);
+  }
+}
+
+TEST(General, Upscalers) {
+  EXPECT_THROW(vid::Upscaler::parse("hq5x"), std::invalid_argument);
+
+  std::array<uint32_t, 512> palette;
+  for (size_t i = 0; i < palette.size(); ++i) {
+    palette[i] = 0xFF000000u | (i == 0x30 ? 0xFFFFFF : 0);
+  }
+  // a white diagonal line on black
+  auto frame = std::make_unique<vid::FrameBuffer>();
+  std::fill(frame->begin(), frame->end(), vid::Pixel{0x0F});
+  for (size_t x = 0; x < vid::HEIGHT; ++x) {
+    (*frame)[x * vid::WIDTH + x] = 0x30;
+  }
+
+  using Kind = vid::Upscaler::Kind;
+  for (auto kind : {Kind::Scale2x, Kind::Scale3x, Kind::Xbr2x}) {
+    vid::Upscaler up(kind);
+    up.setPalette(palette);
+    size_t w = up.width();
+    size_t s = up.scaleX();
+    std::vector<uint32_t> out(w * up.height());
+    up.run(*frame, 0, 0, vid::HEIGHT, out.data(), w * sizeof(uint32_t));
+
+    // away from the line it's black, on it white, and beside it the line
+    // gets filled out into a smooth diagonal rather than a staircase
+    auto at = [&](size_t x, size_t y) { return out[y * w + x] & 0xFFFFFF; };
+    EXPECT_EQ(at(w - 1, 0), 0u) << up.name();
+    EXPECT_EQ(at(100 * s, 100 * s), 0xFFFFFFu) << up.name();
+    EXPECT_NE(at(101 * s, 101 * s - 1), 0u) << up.name();
+  }
+}
+
+TEST(General, LatencyProbe) {
+  sys::LatencyProbe probe;
+  ctrl::JoyPad pad;
+  pad.setProbe(&probe);
+
+  // stages out of order don't count
+  EXPECT_FALSE(probe.applied());
+  probe.polled();
+  EXPECT_FALSE(probe.completed(1));
+  pad.press(ctrl::Button::B);
+
+  // the game reads A (not pressed) then B
+  pad.setStrobe(true);
+  pad.setStrobe(false);
+  EXPECT_EQ(pad.readNext(), 0);
+  EXPECT_EQ(probe.times(sys::LatencyProbe::Read).size(), 0u);
+  EXPECT_EQ(pad.readNext(), 1);
+  EXPECT_EQ(probe.times(sys::LatencyProbe::Read).size(), 1u);
+
+  EXPECT_TRUE(probe.completed(7));
+  // an older frame going up again doesn't show the response
+  probe.presented(6);
+  EXPECT_EQ(probe.total().size(), 0u);
+  probe.presented(7);
+  EXPECT_EQ(probe.total().size(), 1u);
+  for (auto stage : {sys::LatencyProbe::Applied, sys::LatencyProbe::Read,
+                     sys::LatencyProbe::Completed,
+                     sys::LatencyProbe::Presented}) {
+    EXPECT_EQ(probe.times(stage).size(), 1u) << stage;
+  }
+
+  // ready for the next press
+  probe.polled();
+  EXPECT_TRUE(probe.applied());
+}
+
+TEST(General, FramePacer) {
+  sys::FrameTimes times;
+  for (int i = 1; i <= 100; ++i) {
+    times.add(std::chrono::milliseconds(i));
+  }
+  auto s = times.summary();
+  EXPECT_EQ(s.count, 100u);
+  EXPECT_DOUBLE_EQ(s.p50, 50.0);
+  EXPECT_DOUBLE_EQ(s.p99, 99.0);
+  EXPECT_DOUBLE_EQ(s.max, 100.0);
+  EXPECT_DOUBLE_EQ(s.mean, 50.5);
+  EXPECT_NEAR(s.jitter, 28.866, 0.001);
+  std::array<double, 2> bounds = {10.0, 50.0};
+  EXPECT_EQ(times.histogram(bounds), (std::vector<size_t>{9, 40, 51}));
+
+  // deadlines are fixed, so however the waits land, n frames can't take
+  // less than n periods
+  constexpr int N = 20;
+  sys::FramePacer pacer(std::chrono::milliseconds(2));
+  auto start = sys::FramePacer::Clock::now();
+  pacer.resync();
+  for (int i = 0; i < N; ++i) {
+    pacer.wait();
+  }
+  EXPECT_GE(sys::FramePacer::Clock::now() - start, N * pacer.period());
+  EXPECT_EQ(pacer.times().size(), static_cast<size_t>(N));
+}
+
+TEST(General, OutputFilter) {
+  constexpr size_t N = 48000;
+  aud::OutputFilter filter(48000);
+  std::vector<float> in(N, 10000.0f);
+  std::vector<int16_t> out(N);
+
+  // a DC step decays away through the high-passes
+  filter.process(in.data(), out.data(), N);
+  EXPECT_GT(*std::max_element(out.begin(), out.end()), 5000);
+  EXPECT_EQ(out[N - 1], 0);
+
+  // and out-of-range input saturates rather than wrapping
+  filter.reset();
+  std::fill(in.begin(), in.end(), 1e9f);
+  filter.process(in.data(), out.data(), 16);
+  EXPECT_EQ(out[0], 32767);
+
+  // blocks of 8 or more are converted with SSE2 where available, and the
+  // rest one sample at a time. Both must agree bit for bit, saturation
+  // included, so filter a loud signal in one go and again a sample at a time.
+  for (size_t i = 0; i < N; ++i) {
+    in[i] = 100000.0f * std::sin(static_cast<float>(i) * 0.2f) +
+            static_cast<float>(i % 7) * 0.5f;
+  }
+  filter.reset();
+  filter.process(in.data(), out.data(), N);
+  std::vector<int16_t> scalar(N);
+  filter.reset();
+  for (size_t i = 0; i < N; ++i) {
+    filter.process(&in[i], &scalar[i], 1);
+  }
+  EXPECT_EQ(out, scalar);
+  EXPECT_EQ(*std::max_element(out.begin(), out.end()), 32767);
+  EXPECT_EQ(*std::min_element(out.begin(), out.end()), -32768);
+}
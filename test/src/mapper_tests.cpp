@@ -1,19 +1,25 @@
 #include "test_util.hpp"
 
+// mmc3_test_2, one case per single so a failure names the ROM. These run
+// with scanline IRQ prediction, which only kicks in once a ROM settles on the
+// standard pattern table layout, so they cover the prediction and the fall
+// back to edge tracking alike.
 // TODO(oren): these never show the "0x80 in $6000" behavior to indicate that
 // the test is started. No clue how to detect start/stop yet, so they just hang
 // with the usual BLARGG_TEST harness.
-TEST(MapperTest, MMC3) {
-  BLARGG_TEST("rom/1-clocking.nes");
-  BLARGG_TEST("rom/2-details.nes");
-  BLARGG_TEST("rom/3-A12_clocking.nes");
+TEST(MapperTest, MMC3_Clocking) { BLARGG_TEST("rom/1-clocking.nes"); }
 
-  // off by one somehow
-  // BLARGG_TEST("rom/4-scanline_timing.nes");
+TEST(MapperTest, MMC3_Details) { BLARGG_TEST("rom/2-details.nes"); }
 
-  BLARGG_TEST("rom/5-MMC3.nes");
+TEST(MapperTest, MMC3_A12Clocking) { BLARGG_TEST("rom/3-A12_clocking.nes"); }
 
-  // Alternate IRQ behavior around reloads. Don't know how to differentiate at
-  // cart load time, so leaving this as is.
-  /* BLARGG_TEST("rom/6-MMC3_alt.nes"); */
+// off by one somehow
+TEST(MapperTest, DISABLED_MMC3_ScanlineTiming) {
+  BLARGG_TEST("rom/4-scanline_timing.nes");
 }
+
+TEST(MapperTest, MMC3_MMC3) { BLARGG_TEST("rom/5-MMC3.nes"); }
+
+// Alternate IRQ behavior around reloads. Don't know how to differentiate at
+// cart load time, so leaving this as is.
+TEST(MapperTest, DISABLED_MMC3_Alt) { BLARGG_TEST("rom/6-MMC3_alt.nes"); }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <string>
 #include <thread>
 
+#include <unistd.h>
+
 #include "system.hpp"
 
 #include <gtest/gtest.h>
@@ -13,6 +18,39 @@
 // header somewhere.
 using namespace sys;
 
+// A file name in the temp directory that no other test, or concurrent run of
+// this one, will use. Callers clean up after themselves.
+std::filesystem::path temp_path(const std::string &ext) {
+  auto *info = ::testing::UnitTest::GetInstance()->current_test_info();
+  std::string name = std::string("ohnes_") + info->test_suite_name() + "_" +
+                     info->name() + "_" + std::to_string(::getpid()) + ext;
+  return std::filesystem::temp_directory_path() / name;
+}
+
+// Flat 64KiB of memory with $8000-$FFFF reported as 32KiB of PRG ROM. Enough
+// of a mapper to stand up a component (the APU, an expression) on its own.
+class StubMapper : public mapper::NESMapper {
+public:
+  void write(AddressT addr, DataT data) override { mem[addr] = data; }
+  DataT read(AddressT addr, bool) override { return mem[addr]; }
+  DataT dmaRead(AddressT addr) override { return mem[addr]; }
+  void ppu_write(AddressT, DataT) override {}
+  DataT ppu_read(AddressT, bool) override { return 0; }
+  DataT palette_read(AddressT) const override { return 0; }
+  void palette_write(AddressT, DataT) override {}
+  DataT oam_read(AddressT) const override { return 0; }
+  void oam_write(AddressT, DataT) override {}
+  uint8_t mirroring() const override { return 0; }
+  bool setPpuABus(AddressT) override { return false; }
+  void tick(uint16_t) override {}
+  uint8_t openBus() const override { return 0; }
+  int32_t prgRomOffset(AddressT addr) override {
+    return addr < 0x8000 ? -1 : addr - 0x8000;
+  }
+
+  std::array<DataT, 0x10000> mem = {};
+};
+
 bool is_test_complete(NES &nes, uint16_t result_base) {
   static uint8_t gold[3] = {0xDE, 0xB0, 0x61};
   uint8_t status = nes.mapper().read(result_base, true);